@@ -27,6 +27,9 @@ namespace Libshit::Lua
       static_cast<void (::Neptools::Dumpable::*)(const ::boost::filesystem::path &) const>(&::Neptools::Dumpable::Inspect),
       static_cast<std::string (::Neptools::Dumpable::*)() const>(&::Neptools::Dumpable::Inspect)
     >("inspect");
+    bld.AddFunction<
+      static_cast<::Libshit::Lua::RetNum (*)(::Libshit::Lua::StateRef, const ::Neptools::Dumpable &)>(&Neptools::GetMemoryUsage)
+    >("get_memory_usage");
 
   }
   static TypeRegister::StateRegister<::Neptools::Dumpable> reg_neptools_dumpable;
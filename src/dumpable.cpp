@@ -1,7 +1,9 @@
 #include "dumpable.hpp"
 
+#include "memory_usage.hpp"
 #include "sink.hpp"
 
+#include <libshit/lua/function_call.hpp>
 #include <libshit/platform.hpp>
 
 #include <boost/filesystem/operations.hpp>
@@ -45,11 +47,11 @@ namespace Neptools
   {
 #if LIBSHIT_OS_IS_VITA
     // no unique_path on vita
-    Dump(*Sink::ToFile(path, GetSize()));
+    Dump(*Sink::ToGrowingFile(path));
 #else
     auto path2 = path;
     {
-      auto sink = Sink::ToFile(path2+=boost::filesystem::unique_path(), GetSize());
+      auto sink = Sink::ToGrowingFile(path2+=boost::filesystem::unique_path());
       Dump(*sink);
     }
 
@@ -92,6 +94,42 @@ namespace Neptools
     return ss.str();
   }
 
+  void Dumpable::GetMemoryUsage_(MemoryUsage& mu) const
+  {
+    mu.AddObject(typeid(*this), 0);
+  }
+
+#if LIBSHIT_WITH_LUA
+  // {total = bytes, categories = {name = {count = n, bytes = n}}}
+  LIBSHIT_LUAGEN()
+  static Libshit::Lua::RetNum GetMemoryUsage(
+    Libshit::Lua::StateRef vm, const Dumpable& dmp)
+  {
+    MemoryUsage mu;
+    dmp.GetMemoryUsage(mu);
+
+    auto top = lua_gettop(vm);
+    lua_createtable(vm, 0, 2); // +1
+    lua_pushnumber(vm, mu.GetTotal()); // +2
+    lua_setfield(vm, -2, "total"); // +1
+
+    lua_createtable(vm, 0, mu.GetEntries().size()); // +2
+    for (const auto& [name, e] : mu.GetEntries())
+    {
+      lua_createtable(vm, 0, 2); // +3
+      lua_pushnumber(vm, e.count); // +4
+      lua_setfield(vm, -2, "count"); // +3
+      lua_pushnumber(vm, e.bytes); // +4
+      lua_setfield(vm, -2, "bytes"); // +3
+      lua_setfield(vm, -2, name.c_str()); // +2
+    }
+    lua_setfield(vm, -2, "categories"); // +1
+
+    LIBSHIT_LUA_CHECKTOP(vm, top+1);
+    return 1;
+  }
+#endif
+
 }
 
 #include "dumpable.binding.hpp"
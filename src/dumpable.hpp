@@ -2,6 +2,7 @@
 #define UUID_C9446864_0020_4D2F_8E96_CBC6ADCCA3BE
 #pragma once
 
+#include "stats.hpp"
 #include "utils.hpp"
 
 #include <libshit/lua/dynamic_object.hpp>
@@ -14,6 +15,7 @@
 namespace Neptools
 {
 
+  class MemoryUsage;
   class TxtSerializable;
   class Sink;
 
@@ -33,9 +35,13 @@ namespace Neptools
     virtual Libshit::NotNullSharedPtr<TxtSerializable>
     GetDefaultTxtSerializable(const Libshit::NotNullSharedPtr<Dumpable>& thiz);
 
-    void Dump(Sink& os) const { return Dump_(os); }
+    void Dump(Sink& os) const
+    {
+      Stats::PhaseTimer t{Stats::Phase::DUMP};
+      return Dump_(os);
+    }
     LIBSHIT_NOLUA
-    void Dump(Sink&& os) const { return Dump_(os); }
+    void Dump(Sink&& os) const { return Dump(os); }
     void Dump(const boost::filesystem::path& path) const;
 
     LIBSHIT_NOLUA
@@ -47,12 +53,17 @@ namespace Neptools
     void Inspect(const boost::filesystem::path& path) const;
     std::string Inspect() const;
 
+    // Adds the estimated memory used by this object and everything it owns.
+    LIBSHIT_NOLUA void GetMemoryUsage(MemoryUsage& mu) const
+    { return GetMemoryUsage_(mu); }
+
   protected:
     static std::ostream& Indent(std::ostream& os, unsigned indent);
 
   private:
     virtual void Dump_(Sink& sink) const = 0;
     virtual void Inspect_(std::ostream& os, unsigned indent) const = 0;
+    virtual void GetMemoryUsage_(MemoryUsage& mu) const;
   };
 
   std::ostream& operator<<(std::ostream& os, const Dumpable& dmp);
@@ -9,6 +9,7 @@
 #include <libshit/lua/value_object.hpp>
 
 #include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <memory>
@@ -40,21 +41,28 @@ namespace Neptools
   {
     LIBSHIT_LUA_CLASS;
   private:
-    template <typename Ret, size_t I, typename T, typename... TRest,
-              typename Thiz, typename Fun, typename... FunArgs>
-      static Ret VisitHlp(Thiz thiz, size_t i, Fun&& fun, FunArgs&&... args)
+    template <typename Ret, typename T, typename Thiz, typename Fun,
+              typename... FunArgs>
+    static Ret VisitOne(Thiz thiz, size_t i, Fun&& fun, FunArgs&&... args)
     {
-      if (thiz->type->items[i].idx == I)
-        return fun(thiz->template Get<T>(i), thiz->GetSize(i),
-                   std::forward<FunArgs>(args)...);
-      else
-        return VisitHlp<Ret, I+1, TRest...>(
-          thiz, i, std::forward<Fun>(fun), std::forward<FunArgs>(args)...);
+      return fun(thiz->template Get<T>(i), thiz->GetSize(i),
+                 std::forward<FunArgs>(args)...);
     }
 
-    template <typename Ret, size_t I, typename Thiz, typename Fun,
-              typename... FunArgs>
-    static Ret VisitHlp(Thiz, size_t, Fun&&, FunArgs&&...) { abort(); }
+    // one entry per Args, indexed by items[i].idx, so a visit is a single
+    // indirect call instead of a chain of compares
+    template <typename Ret, typename Thiz, typename Fun, typename... FunArgs>
+    static Ret VisitHlp(Thiz thiz, size_t i, Fun&& fun, FunArgs&&... args)
+    {
+      using Handler = Ret (*)(Thiz, size_t, Fun&&, FunArgs&&...);
+      static constexpr const Handler HANDLERS[] =
+        { &VisitOne<Ret, Args, Thiz, Fun, FunArgs...>... };
+
+      auto idx = thiz->type->items[i].idx;
+      LIBSHIT_ASSERT(idx < sizeof...(Args));
+      return HANDLERS[idx](
+        thiz, i, std::forward<Fun>(fun), std::forward<FunArgs>(args)...);
+    }
 
   public:
     template <typename T>
@@ -163,6 +171,40 @@ namespace Neptools
       }
     }
 
+    /// Create count structs of the same type in one allocation, calling
+    /// fun(boost::intrusive_ptr<DynamicStruct>) with each. The memory is freed
+    /// when the last of them dies.
+    template <typename Fun>
+    LIBSHIT_NOLUA static void NewArray(
+      const TypePtr& type, size_t count, Fun fun)
+    {
+      if (count == 0) return;
+      auto stride = (sizeof(DynamicStruct) - 1 + type->byte_size +
+                     alignof(DynamicStruct) - 1) /
+        alignof(DynamicStruct) * alignof(DynamicStruct);
+      auto bytes = sizeof(Arena) + count * stride;
+      auto ptr = ::operator new(bytes);
+      // keep it alive while creating the items
+      auto arena = new (ptr) Arena{{1}, bytes};
+
+      try
+      {
+        auto base = reinterpret_cast<char*>(arena + 1);
+        for (size_t i = 0; i < count; ++i)
+        {
+          auto obj = new (base + i*stride) DynamicStruct{type, arena};
+          arena->refcount.fetch_add(1, std::memory_order_relaxed);
+          fun(boost::intrusive_ptr<DynamicStruct>{obj, false});
+        }
+      }
+      catch (...)
+      {
+        Arena::Release(arena);
+        throw;
+      }
+      Arena::Release(arena);
+    }
+
     DynamicStruct(const DynamicStruct&) = delete;
     void operator=(const DynamicStruct&) = delete;
     ~DynamicStruct()
@@ -191,6 +233,22 @@ namespace Neptools
     }
 
     const TypePtr& GetType() const noexcept { return type; }
+
+    /// The heap block holding this struct and its size in bytes: the whole
+    /// NewArray block if it was created by NewArray (shared with the other
+    /// structs created there, and kept until all of them die), its own
+    /// allocation otherwise.
+    LIBSHIT_NOLUA const void* GetAllocation(size_t& size) const noexcept
+    {
+      if (arena)
+      {
+        size = arena->bytes;
+        return arena;
+      }
+      size = sizeof(DynamicStruct) - 1 + type->byte_size;
+      return this;
+    }
+
     LIBSHIT_NOLUA void* GetData() noexcept { return data; }
     LIBSHIT_NOLUA const void* GetData() const noexcept { return data; }
 
@@ -221,7 +279,7 @@ namespace Neptools
 
     template <typename Ret = void, typename... FunArgs>
     LIBSHIT_NOLUA Ret Visit(size_t i, FunArgs&&... f)
-    { return VisitHlp<Ret, 0, Args...>(this, i, std::forward<FunArgs>(f)...); }
+    { return VisitHlp<Ret>(this, i, std::forward<FunArgs>(f)...); }
 
     template <typename... FunArgs>
     LIBSHIT_NOLUA void ForEach(FunArgs&&... f)
@@ -233,7 +291,7 @@ namespace Neptools
     // const version
     template <typename Ret = void, typename... FunArgs>
     LIBSHIT_NOLUA Ret Visit(size_t i, FunArgs&&... f) const
-    { return VisitHlp<Ret, 0, Args...>(this, i, std::forward<FunArgs>(f)...); }
+    { return VisitHlp<Ret>(this, i, std::forward<FunArgs>(f)...); }
 
     template <typename... FunArgs>
     LIBSHIT_NOLUA void ForEach(FunArgs&&... args) const
@@ -243,7 +301,23 @@ namespace Neptools
     }
 
   private:
-    DynamicStruct(TypePtr type) : type{std::move(type)}
+    struct alignas(std::max_align_t) Arena
+    {
+      std::atomic<size_t> refcount;
+      size_t bytes; // including this header
+
+      static void Release(Arena* a) noexcept
+      {
+        if (a->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+          a->~Arena();
+          ::operator delete(a);
+        }
+      }
+    };
+
+    DynamicStruct(TypePtr type, Arena* arena = nullptr)
+      : type{std::move(type)}, arena{arena}
     {
       size_t i = 0;
       try
@@ -274,6 +348,7 @@ namespace Neptools
 
     TypePtr type;
     mutable std::atomic<size_t> refcount{1};
+    Arena* arena; // if allocated by NewArray
     char data[1];
 
     friend void intrusive_ptr_add_ref(const DynamicStruct* t)
@@ -283,8 +358,10 @@ namespace Neptools
     {
       if (t->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1)
       {
+        auto arena = t->arena;
         t->~DynamicStruct();
-        ::operator delete(const_cast<DynamicStruct*>(t));
+        if (arena) Arena::Release(arena);
+        else ::operator delete(const_cast<DynamicStruct*>(t));
       }
     }
   };
@@ -1,2 +1,91 @@
 #include "endian.hpp"
+
+#include <libshit/doctest.hpp>
+
+#if NEPTOOLS_ENDIAN_SIMD
+#  include <cpuid.h>
+#endif
+
+namespace Neptools
+{
+  TEST_SUITE_BEGIN("Neptools::Endian");
+
+#if NEPTOOLS_ENDIAN_SIMD
+  bool Detail::HasSsse3() noexcept
+  {
+#  ifdef __SSSE3__
+    return true;
+#  else
+    static const bool ssse3 = []
+    {
+      unsigned a, b, c, d;
+      return __get_cpuid(1, &a, &b, &c, &d) && (c & bit_SSSE3);
+    }();
+    return ssse3;
+#  endif
+  }
+#endif
+
+  struct EndianTestStruct
+  {
+    std::uint32_t a;
+    char str[2];
+    std::uint16_t b;
+    std::uint64_t c;
+  };
+  static_assert(sizeof(EndianTestStruct) == 16);
+  NEPTOOLS_ENDIAN_FIELDS(EndianTestStruct, a, b, c);
+
+  struct EndianTestSmall { std::uint16_t x, y; };
+  NEPTOOLS_ENDIAN_FIELDS(EndianTestSmall, x, y);
+
+  TEST_CASE("struct swap")
+  {
+    EndianTestStruct s{0x12345678, {'a', 'b'}, 0xabcd, 0x0102030405060708};
+    EndianReverseInplace(s);
+    CHECK(s.a == 0x78563412);
+    CHECK(s.str[0] == 'a'); CHECK(s.str[1] == 'b');
+    CHECK(s.b == 0xcdab);
+    CHECK(s.c == 0x0807060504030201);
+  }
+
+  TEST_CASE("array swap")
+  {
+    EndianTestStruct arr[5], exp[5];
+    for (std::uint32_t i = 0; i < 5; ++i)
+    {
+      arr[i] = {i, {char(i), char(i+1)}, std::uint16_t(i*3),
+                std::uint64_t(i) << 40 | 0x1234};
+      exp[i] = arr[i];
+      EndianReverseInplace(exp[i]);
+    }
+
+    EndianTestStruct arr2[5];
+    memcpy(arr2, arr, sizeof(arr));
+    EndianReverseArray(arr, 5);
+    CHECK(memcmp(arr, exp, sizeof(arr)) == 0);
+
+#if NEPTOOLS_ENDIAN_SIMD
+    // the shuffle path, even if EndianReverseArray didn't use it
+    if (Detail::HasSsse3())
+    {
+      CHECK(Detail::EndianReverseArraySsse3(arr2, 5) == 5);
+      CHECK(memcmp(arr2, exp, sizeof(arr2)) == 0);
+    }
+#endif
+
+    // multiple structs per shuffle + remainder
+    EndianTestSmall small[7];
+    for (std::uint16_t i = 0; i < 7; ++i) small[i] = {i, std::uint16_t(i+256)};
+    EndianReverseArray(small, 7);
+    for (std::uint16_t i = 0; i < 7; ++i)
+    {
+      CHECK(small[i].x == i << 8);
+      CHECK(small[i].y == ((i << 8) | 1));
+    }
+  }
+
+  TEST_SUITE_END();
+}
+
 #include "endian.binding.hpp"
@@ -6,7 +6,22 @@
 #include <libshit/meta.hpp>
 #include <libshit/lua/type_traits.hpp>
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
 #include <boost/endian/conversion.hpp>
+#include <boost/preprocessor/seq/for_each.hpp>
+#include <boost/preprocessor/variadic/to_seq.hpp>
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+  (defined(__i386__) || defined(__x86_64__))
+#  define NEPTOOLS_ENDIAN_SIMD 1
+#  include <tmmintrin.h>
+#else
+#  define NEPTOOLS_ENDIAN_SIMD 0
+#endif
 
 namespace Neptools
 {
@@ -64,6 +79,159 @@ namespace Neptools
       t, ToBoost(e), boost::endian::order::native);
   }
 
+  // Byte swapping of on-disk structs. Describe the fields that need swapping
+  // with NEPTOOLS_ENDIAN_FIELDS(Type, field, ...) in the struct's namespace
+  // (unlisted fields, like char arrays, are left alone), it defines
+  // endian_reverse_inplace/endian_reverse for ToNative & co. Arrays can be
+  // swapped with ToNativeArray/FromNativeArray.
+  struct EndianField { std::size_t offset, size; };
+  template <typename T> struct EndianLayout;
+
+  namespace Detail
+  {
+    template <typename T>
+    struct EndianShuffle
+    {
+      static constexpr std::size_t SIZE = sizeof(T);
+
+      // source index of every byte
+      static constexpr std::array<std::size_t, SIZE> MakeMap()
+      {
+        std::array<std::size_t, SIZE> ret{};
+        for (std::size_t i = 0; i < SIZE; ++i) ret[i] = i;
+        for (const auto& f : EndianLayout<T>::FIELDS)
+          for (std::size_t i = 0; i < f.size; ++i)
+            ret[f.offset + i] = f.offset + f.size - 1 - i;
+        return ret;
+      }
+      static constexpr auto MAP = MakeMap();
+
+      // can we do it with 16-byte shuffles? T must be a multiple of 16 bytes
+      // without fields crossing 16 byte boundaries, or its size must divide 16
+      static constexpr bool MakeBlockOk()
+      {
+        if (SIZE % 16 != 0 && 16 % SIZE != 0) return false;
+        for (const auto& f : EndianLayout<T>::FIELDS)
+          if (f.offset / 16 != (f.offset + f.size - 1) / 16) return false;
+        return true;
+      }
+      static constexpr bool BLOCK_OK = MakeBlockOk();
+      static constexpr std::size_t BLOCK = SIZE > 16 ? SIZE : 16;
+
+      using Masks = std::array<std::array<std::uint8_t, 16>, BLOCK / 16>;
+      static constexpr Masks MakeMasks()
+      {
+        Masks ret{};
+        for (std::size_t i = 0; i < BLOCK; ++i)
+          ret[i/16][i%16] = (MAP[i % SIZE] + i / SIZE * SIZE) % 16;
+        return ret;
+      }
+      static constexpr Masks MASKS = MakeMasks();
+    };
+
+    template <std::size_t Size> struct EndianUint;
+    template <> struct EndianUint<2> { using Type = std::uint16_t; };
+    template <> struct EndianUint<4> { using Type = std::uint32_t; };
+    template <> struct EndianUint<8> { using Type = std::uint64_t; };
+
+    template <std::size_t Offset, std::size_t Size>
+    inline void EndianReverseField(unsigned char* p) noexcept
+    {
+      static_assert(Size == 2 || Size == 4 || Size == 8,
+                    "Invalid endian field size");
+      typename EndianUint<Size>::Type x;
+      std::memcpy(&x, p + Offset, Size);
+      boost::endian::endian_reverse_inplace(x);
+      std::memcpy(p + Offset, &x, Size);
+    }
+
+    template <typename T, std::size_t... I>
+    inline void EndianReverseFields(
+      unsigned char* p, std::index_sequence<I...>) noexcept
+    {
+      (EndianReverseField<EndianLayout<T>::FIELDS[I].offset,
+                          EndianLayout<T>::FIELDS[I].size>(p), ...);
+    }
+
+#if NEPTOOLS_ENDIAN_SIMD
+    // cached cpuid check, in endian.cpp
+    bool HasSsse3() noexcept;
+
+    // swap as many Ts as possible with 16-byte shuffles, returns their count.
+    // Only call it if HasSsse3().
+    template <typename T>
+    __attribute__((target("ssse3")))
+    std::size_t EndianReverseArraySsse3(T* ts, std::size_t n) noexcept
+    {
+      using Shuffle = EndianShuffle<T>;
+      static_assert(Shuffle::BLOCK_OK);
+      __m128i masks[Shuffle::BLOCK / 16];
+      for (std::size_t i = 0; i < Shuffle::BLOCK / 16; ++i)
+        masks[i] = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(Shuffle::MASKS[i].data()));
+
+      auto begin = reinterpret_cast<unsigned char*>(ts);
+      auto p = begin, end = begin + n * sizeof(T);
+      for (; std::size_t(end - p) >= Shuffle::BLOCK; p += Shuffle::BLOCK)
+        for (std::size_t i = 0; i < Shuffle::BLOCK / 16; ++i)
+        {
+          auto pi = reinterpret_cast<__m128i*>(p + i*16);
+          _mm_storeu_si128(pi, _mm_shuffle_epi8(_mm_loadu_si128(pi), masks[i]));
+        }
+      return (p - begin) / sizeof(T);
+    }
+#endif
+  }
+
+  template <typename T>
+  inline void EndianReverseInplace(T& t) noexcept
+  {
+    Detail::EndianReverseFields<T>(
+      reinterpret_cast<unsigned char*>(&t),
+      std::make_index_sequence<std::size(EndianLayout<T>::FIELDS)>{});
+  }
+
+  template <typename T>
+  inline void EndianReverseArray(T* ts, std::size_t n) noexcept
+  {
+#if NEPTOOLS_ENDIAN_SIMD
+    if constexpr (Detail::EndianShuffle<T>::BLOCK_OK)
+      if (Detail::HasSsse3())
+      {
+        auto done = Detail::EndianReverseArraySsse3(ts, n);
+        ts += done;
+        n -= done;
+      }
+#endif
+    for (std::size_t i = 0; i < n; ++i) EndianReverseInplace(ts[i]);
+  }
+
+  template <typename T>
+  inline void ToNativeArray(T* ts, std::size_t n, Endian e) noexcept
+  {
+    if (ToBoost(e) != boost::endian::order::native) EndianReverseArray(ts, n);
+  }
+
+  template <typename T>
+  inline void FromNativeArray(T* ts, std::size_t n, Endian e) noexcept
+  { ToNativeArray(ts, n, e); }
+
+#define NEPTOOLS_ENDIAN_FIELD(r, type, field) \
+  ::Neptools::EndianField{offsetof(type, field), sizeof(type::field)},
+
+#define NEPTOOLS_ENDIAN_FIELDS(type, ...)                                 \
+  template<> struct EndianLayout<type>                                    \
+  {                                                                       \
+    static constexpr ::Neptools::EndianField FIELDS[] = {                 \
+      BOOST_PP_SEQ_FOR_EACH(                                              \
+        NEPTOOLS_ENDIAN_FIELD, type, BOOST_PP_VARIADIC_TO_SEQ(__VA_ARGS__)) \
+    };                                                                    \
+  };                                                                      \
+  inline void endian_reverse_inplace(type& t) noexcept                    \
+  { ::Neptools::EndianReverseInplace(t); }                                \
+  inline type endian_reverse(type t) noexcept                             \
+  { ::Neptools::EndianReverseInplace(t); return t; }
+
 }
 
 LIBSHIT_ENUM(Neptools::Endian);
@@ -1,6 +1,8 @@
 #include "cl3.hpp"
 #include "stcm/file.hpp"
+#include "../memory_usage.hpp"
 #include "../open.hpp"
+#include "../trace.hpp"
 
 #include <libshit/char_utils.hpp>
 #include <libshit/except.hpp>
@@ -24,15 +26,6 @@ namespace Neptools
 #undef VALIDATE
   }
 
-  void endian_reverse_inplace(Cl3::Header& hdr) noexcept
-  {
-    boost::endian::endian_reverse_inplace(hdr.field_04);
-    boost::endian::endian_reverse_inplace(hdr.field_08);
-    boost::endian::endian_reverse_inplace(hdr.sections_count);
-    boost::endian::endian_reverse_inplace(hdr.sections_offset);
-    boost::endian::endian_reverse_inplace(hdr.field_14);
-  }
-
   void Cl3::Section::Validate(FilePosition file_size) const
   {
 #define VALIDATE(x) LIBSHIT_VALIDATE_FIELD("Cl3::Section", x)
@@ -45,22 +38,6 @@ namespace Neptools
 #undef VALIDATE
   }
 
-  void endian_reverse_inplace(Cl3::Section& sec) noexcept
-  {
-    boost::endian::endian_reverse_inplace(sec.count);
-    boost::endian::endian_reverse_inplace(sec.data_size);
-    boost::endian::endian_reverse_inplace(sec.data_offset);
-    boost::endian::endian_reverse_inplace(sec.field_2c);
-    boost::endian::endian_reverse_inplace(sec.field_30);
-    boost::endian::endian_reverse_inplace(sec.field_34);
-    boost::endian::endian_reverse_inplace(sec.field_38);
-    boost::endian::endian_reverse_inplace(sec.field_3c);
-    boost::endian::endian_reverse_inplace(sec.field_40);
-    boost::endian::endian_reverse_inplace(sec.field_44);
-    boost::endian::endian_reverse_inplace(sec.field_48);
-    boost::endian::endian_reverse_inplace(sec.field_4c);
-  }
-
   void Cl3::FileEntry::Validate(uint32_t block_size) const
   {
 #define VALIDATE(x) LIBSHIT_VALIDATE_FIELD("Cl3::FileEntry", x)
@@ -72,22 +49,6 @@ namespace Neptools
 #undef VALIDATE
   }
 
-  void endian_reverse_inplace(Cl3::FileEntry& entry) noexcept
-  {
-    boost::endian::endian_reverse_inplace(entry.field_200);
-    boost::endian::endian_reverse_inplace(entry.data_offset);
-    boost::endian::endian_reverse_inplace(entry.data_size);
-    boost::endian::endian_reverse_inplace(entry.link_start);
-    boost::endian::endian_reverse_inplace(entry.link_count);
-    boost::endian::endian_reverse_inplace(entry.field_214);
-    boost::endian::endian_reverse_inplace(entry.field_218);
-    boost::endian::endian_reverse_inplace(entry.field_21c);
-    boost::endian::endian_reverse_inplace(entry.field_220);
-    boost::endian::endian_reverse_inplace(entry.field_224);
-    boost::endian::endian_reverse_inplace(entry.field_228);
-    boost::endian::endian_reverse_inplace(entry.field_22c);
-  }
-
   void Cl3::LinkEntry::Validate(uint32_t i, uint32_t file_count) const
   {
 #define VALIDATE(x) LIBSHIT_VALIDATE_FIELD("Cl3::LinkEntry", x)
@@ -99,18 +60,6 @@ namespace Neptools
 #undef VALIDATE
   }
 
-  void endian_reverse_inplace(Cl3::LinkEntry& entry) noexcept
-  {
-    boost::endian::endian_reverse_inplace(entry.field_00);
-    boost::endian::endian_reverse_inplace(entry.linked_file_id);
-    boost::endian::endian_reverse_inplace(entry.link_id);
-    boost::endian::endian_reverse_inplace(entry.field_0c);
-    boost::endian::endian_reverse_inplace(entry.field_10);
-    boost::endian::endian_reverse_inplace(entry.field_14);
-    boost::endian::endian_reverse_inplace(entry.field_18);
-    boost::endian::endian_reverse_inplace(entry.field_1c);
-  }
-
   void Cl3::Entry::Dispose() noexcept
   {
     links.clear();
@@ -119,6 +68,7 @@ namespace Neptools
 
   Cl3::Cl3(Source src)
   {
+    Stats::PhaseTimer t{Stats::Phase::PARSE};
     ADD_SOURCE(Parse_(src), src);
   }
 
@@ -192,6 +142,7 @@ namespace Neptools
 
   void Cl3::Parse_(Source& src)
   {
+    Trace::Scope tr{"Cl3::Parse_"};
     src.CheckSize(sizeof(Header));
     auto hdr = src.PreadGen<Header>(0);
     endian = hdr.endian == 'L' ? Endian::LITTLE : Endian::BIG;
@@ -200,14 +151,14 @@ namespace Neptools
 
     field_14 = hdr.field_14;
 
-    src.Seek(hdr.sections_offset);
+    SourceCursor cur{src, hdr.sections_offset};
     uint32_t secs = hdr.sections_count;
 
-    uint32_t file_offset = 0, file_count = 0, file_size,
-      link_offset, link_count = 0;
+    uint32_t file_offset = 0, file_count = 0, file_size = 0,
+      link_offset = 0, link_count = 0;
     for (size_t i = 0; i < secs; ++i)
     {
-      auto sec = src.ReadGen<Section>();
+      auto sec = cur.ReadGen<Section>();
       ToNative(sec, endian);
       sec.Validate(src.GetSize());
 
@@ -227,32 +178,41 @@ namespace Neptools
       }
     }
 
+    LIBSHIT_VALIDATE_FIELD(
+      "Cl3::Section", file_count <= file_size / sizeof(FileEntry));
+
+    // read both tables in one go, then build everything from memory
+    std::vector<FileEntry> fes(file_count);
+    src.Pread(file_offset, reinterpret_cast<Byte*>(fes.data()),
+              file_count * sizeof(FileEntry));
+    std::vector<LinkEntry> les(link_count);
+    if (link_count)
+      src.Pread(link_offset, reinterpret_cast<Byte*>(les.data()),
+                link_count * sizeof(LinkEntry));
+    ToNativeArray(fes.data(), fes.size(), endian);
+    ToNativeArray(les.data(), les.size(), endian);
+
     entries.reserve(file_count);
-    src.Seek(file_offset);
-    for (uint32_t i = 0; i < file_count; ++i)
+    for (const auto& e : fes)
     {
-      auto e = src.ReadGen<FileEntry>();
-      ToNative(e, endian);
       e.Validate(file_size);
+      LIBSHIT_VALIDATE_FIELD(
+        "Cl3::FileEntry", e.link_start <= link_count &&
+        e.link_count <= link_count - e.link_start);
 
       entries.emplace_back(
         e.name.c_str(), e.field_200, Libshit::MakeSmart<DumpableSource>(
           src, file_offset+e.data_offset, e.data_size));
     }
 
-    src.Seek(file_offset);
     for (uint32_t i = 0; i < file_count; ++i)
     {
-      auto e = src.ReadGen<FileEntry>();
-      ToNative(e, endian);
       auto& ls = entries[i].links;
-      uint32_t lbase = e.link_start;
-      uint32_t lcount = e.link_count;
-
-      for (uint32_t i = lbase; i < lbase+lcount; ++i)
+      ls.reserve(fes[i].link_count);
+      for (uint32_t j = 0; j < fes[i].link_count; ++j)
       {
-        auto le = src.PreadGen<LinkEntry>(link_offset + i*sizeof(LinkEntry));
-        le.Validate(i - lbase, file_count);
+        const auto& le = les[fes[i].link_start + j];
+        le.Validate(j, file_count);
         ls.emplace_back(&entries[le.linked_file_id]);
       }
     }
@@ -262,6 +222,8 @@ namespace Neptools
   static constexpr unsigned PAD = 0x3f;
   void Cl3::Fixup()
   {
+    Trace::Scope tr{"Cl3::Fixup"};
+    Stats::PhaseTimer t{Stats::Phase::FIXUP};
     data_size = 0;
     link_count = 0;
     for (auto& e : entries)
@@ -304,7 +266,7 @@ namespace Neptools
     for (const auto& e : entries)
     {
       if (!e.src) continue;
-      auto sink = Sink::ToFile(dir / e.name.c_str(), e.src->GetSize());
+      auto sink = Sink::ToGrowingFile(dir / e.name.c_str());
       e.src->Dump(*sink);
     }
   }
@@ -358,21 +320,21 @@ namespace Neptools
     os << "})";
   }
 
-  // workaround, revert to template if/when
-  // https://github.com/boostorg/endian/issues/41 is fixed
-#define GEN_REVERSE(T)                  \
-  static T endian_reverse(T t) noexcept \
-  {                                     \
-    endian_reverse_inplace(t);          \
-    return t;                           \
+  void Cl3::GetMemoryUsage_(MemoryUsage& mu) const
+  {
+    mu.AddObject(typeid(*this), sizeof(*this));
+    for (auto& e : entries)
+    {
+      mu.Add("Cl3::Entry", sizeof(Entry) +
+             e.links.capacity() * sizeof(Entry::Links::value_type));
+      mu.AddString(e.name);
+      if (e.src) e.src->GetMemoryUsage(mu);
+    }
   }
-  GEN_REVERSE(Cl3::Section);
-  GEN_REVERSE(Cl3::FileEntry);
-  GEN_REVERSE(Cl3::LinkEntry);
-#undef GEN_REVERSE
 
   void Cl3::Dump_(Sink& sink) const
   {
+    Trace::Scope tr{"Cl3::Dump_"};
     auto sections_offset = (sizeof(Header)+PAD) & ~PAD;
     auto files_offset = (sections_offset+sizeof(Section)*2+PAD) & ~PAD;
     auto data_offset = (files_offset+sizeof(FileEntry)*entries.size()+PAD) & ~PAD;
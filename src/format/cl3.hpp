@@ -159,11 +159,20 @@ namespace Neptools
     void Parse_(Source& src);
     void Dump_(Sink& os) const override;
     void Inspect_(std::ostream& os, unsigned indent) const override;
+    void GetMemoryUsage_(MemoryUsage& mu) const override;
   };
 
-  void endian_reverse_inplace(Cl3::Header& hdr) noexcept;
-  void endian_reverse_inplace(Cl3::Section& sec) noexcept;
-  void endian_reverse_inplace(Cl3::FileEntry& entry) noexcept;
-  void endian_reverse_inplace(Cl3::LinkEntry& entry) noexcept;
+  NEPTOOLS_ENDIAN_FIELDS(
+    Cl3::Header, field_04, field_08, sections_count, sections_offset, field_14);
+  NEPTOOLS_ENDIAN_FIELDS(
+    Cl3::Section, count, data_size, data_offset, field_2c, field_30, field_34,
+    field_38, field_3c, field_40, field_44, field_48, field_4c);
+  NEPTOOLS_ENDIAN_FIELDS(
+    Cl3::FileEntry, field_200, data_offset, data_size, link_start, link_count,
+    field_214, field_218, field_21c, field_220, field_224, field_228,
+    field_22c);
+  NEPTOOLS_ENDIAN_FIELDS(
+    Cl3::LinkEntry, field_00, linked_file_id, link_id, field_0c, field_10,
+    field_14, field_18, field_1c);
 }
 #endif
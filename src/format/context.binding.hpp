@@ -38,6 +38,24 @@ namespace Libshit::Lua
     bld.AddFunction<
       static_cast<::Neptools::ItemPointer (::Neptools::Context::*)(::Neptools::FilePosition) const noexcept>(&::Neptools::Context::GetPointer)
     >("get_pointer");
+    bld.AddFunction<
+      TableRetWrap<static_cast<::Neptools::Context::ItemVector (::Neptools::Context::*)(const ::Neptools::Label &)>(&::Neptools::Context::GetReferences)>::Wrap
+    >("get_references");
+    bld.AddFunction<
+      TableRetWrap<static_cast<::Neptools::Context::ItemVector (::Neptools::Context::*)(const ::Neptools::Label &)>(&::Neptools::Context::GetCallers)>::Wrap
+    >("get_callers");
+    bld.AddFunction<
+      TableRetWrap<static_cast<::Neptools::Context::ItemVector (::Neptools::Context::*)(::uint32_t)>(&::Neptools::Context::GetInstructionsByOpcode)>::Wrap
+    >("get_instructions_by_opcode");
+    bld.AddFunction<
+      TableRetWrap<static_cast<std::vector<::Libshit::NotNull<::Neptools::LabelPtr> > (::Neptools::Context::*)(const ::Neptools::Item &)>(&::Neptools::Context::GetCallees)>::Wrap
+    >("get_callees");
+    bld.AddFunction<
+      static_cast<void (::Neptools::Context::*)(::Neptools::Item &) noexcept>(&::Neptools::Context::UpdateXref)
+    >("update_xref");
+    bld.AddFunction<
+      static_cast<bool (::Neptools::Context::*)(const ::Neptools::Item &) const noexcept>(&::Neptools::Context::IsAttached)
+    >("is_attached");
 
   }
   static TypeRegister::StateRegister<::Neptools::Context> reg_neptools_context;
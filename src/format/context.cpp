@@ -1,5 +1,8 @@
 #include "context.hpp"
 #include "item.hpp"
+#include "xref.hpp"
+#include "../memory_usage.hpp"
+#include "../trace.hpp"
 #include "../utils.hpp"
 
 #include <libshit/except.hpp>
@@ -28,6 +31,9 @@ namespace Neptools
 
   void Context::Fixup()
   {
+    Trace::Scope tr{"Context::Fixup"};
+    Stats::PhaseTimer t{Stats::Phase::FIXUP};
+    Stats::Add(Stats::Counter::FIXUP_PASSES);
     pmap.clear();
 
     FilePosition pos = 0;
@@ -39,6 +45,30 @@ namespace Neptools
     // todo? size = pos;
   }
 
+  void Context::Dump_(Sink& sink) const
+  {
+    Trace::Scope tr{"Context::Dump_"};
+    ItemWithChildren::Dump_(sink);
+  }
+
+  void Context::GetMemoryUsage_(MemoryUsage& mu) const
+  {
+    // contexts are not created with Create, so their size is not registered
+    mu.AddExtra(typeid(*this), sizeof(Context) - sizeof(Item));
+    ItemWithChildren::GetMemoryUsage_(mu);
+
+    for (auto& l : labels)
+    {
+      mu.Add("Label", sizeof(Label));
+      mu.AddString(l.GetName());
+    }
+    // map nodes: value + 3 pointers + color
+    if (!pmap.empty())
+      mu.Add("Context pointer map",
+             pmap.size() * (sizeof(PointerMap::value_type) + 4*sizeof(void*)),
+             pmap.size());
+  }
+
 
   Libshit::NotNull<LabelPtr> Context::GetLabel(const std::string& name) const
   {
@@ -151,8 +181,83 @@ namespace Neptools
     return {it->second, pos - it->first};
   }
 
+  XrefIndex& Context::GetXref()
+  {
+    if (!xref)
+    {
+      auto x = std::make_unique<XrefIndex>();
+      for (auto& c : GetChildren()) x->Add(c);
+      xref = std::move(x);
+    }
+    else
+      for (auto i : xref_volatile) xref->Update(*i);
+    return *xref;
+  }
+
+  static Context::ItemVector ToItemVector(const std::vector<Item*>& v)
+  {
+    Context::ItemVector ret;
+    ret.reserve(v.size());
+    for (auto i : v) ret.push_back(Libshit::MakeNotNull(i));
+    return ret;
+  }
+
+  Context::ItemVector Context::GetReferences(const Label& label)
+  {
+    return ToItemVector(GetXref().GetReferences(
+      label, unsigned(XrefKind::DATA) | unsigned(XrefKind::CODE)));
+  }
+
+  Context::ItemVector Context::GetCallers(const Label& label)
+  {
+    return ToItemVector(GetXref().GetReferences(
+      label, unsigned(XrefKind::CODE)));
+  }
+
+  Context::ItemVector Context::GetInstructionsByOpcode(uint32_t opcode)
+  { return ToItemVector(GetXref().GetByOpcode(opcode)); }
+
+  std::vector<Libshit::NotNull<LabelPtr>> Context::GetCallees(const Item& item)
+  {
+    std::vector<Libshit::NotNull<LabelPtr>> ret;
+    auto e = GetXref().GetEntry(item);
+    if (!e) return ret;
+    for (const auto& [lbl, kind] : e->labels)
+    {
+      if (kind != XrefKind::CODE) continue;
+      // the entry can be stale if the item was changed without UpdateXref,
+      // don't return labels already removed from the context
+      auto it = labels.find(lbl->GetName());
+      if (it != labels.end() && &*it == lbl.get())
+        ret.push_back(Libshit::MakeNotNull(lbl));
+    }
+    return ret;
+  }
+
+  void Context::UpdateXref(Item& item) noexcept
+  {
+    if (!xref) return;
+    if (!IsAttached(item))
+    {
+      xref->Remove(item);
+      return;
+    }
+
+    try { xref->Update(item); }
+    catch (...) { xref.reset(); }
+  }
+
+  bool Context::IsAttached(const Item& item) const noexcept
+  {
+    auto p = item.GetParent();
+    while (p && p != this) p = p->GetParent();
+    return p;
+  }
+
   void Context::Dispose() noexcept
   {
+    xref.reset();
+    xref_volatile.clear();
     pmap.clear();
     struct Disposer
     {
@@ -182,4 +287,5 @@ namespace Neptools
 
 }
 
+#include <libshit/lua/table_ret_wrap.hpp>
 #include "context.binding.hpp"
@@ -8,10 +8,15 @@
 #include <boost/intrusive/set.hpp>
 #include <string>
 #include <map>
+#include <memory>
+#include <unordered_set>
+#include <vector>
 
 namespace Neptools
 {
 
+  class XrefIndex;
+
   class Context : public ItemWithChildren
   {
     LIBSHIT_LUA_CLASS;
@@ -24,8 +29,10 @@ namespace Neptools
     template <typename T, typename... Args>
     LIBSHIT_NOLUA Libshit::NotNull<Libshit::SmartPtr<T>> Create(Args&&... args)
     {
-      return Libshit::MakeSmart<T>(
+      auto ret = Libshit::MakeSmart<T>(
         Item::Key{}, *this, std::forward<Args>(args)...);
+      Stats::ItemCreated<T>();
+      return ret;
     }
 
     Libshit::NotNull<LabelPtr> GetLabel(const std::string& name) const;
@@ -47,10 +54,28 @@ namespace Neptools
 
     ItemPointer GetPointer(FilePosition pos) const noexcept;
 
+    // cross references, sorted by position
+    using ItemVector = std::vector<Libshit::NotNull<Libshit::SmartPtr<Item>>>;
+    LIBSHIT_LUAGEN(wrap="TableRetWrap")
+    ItemVector GetReferences(const Label& label);
+    LIBSHIT_LUAGEN(wrap="TableRetWrap")
+    ItemVector GetCallers(const Label& label);
+    LIBSHIT_LUAGEN(wrap="TableRetWrap")
+    ItemVector GetInstructionsByOpcode(uint32_t opcode);
+    LIBSHIT_LUAGEN(wrap="TableRetWrap")
+    std::vector<Libshit::NotNull<LabelPtr>> GetCallees(const Item& item);
+
+    // Call after changing references of an item outside of its setters. No-op
+    // if the index is not built yet.
+    void UpdateXref(Item& item) noexcept;
+    bool IsAttached(const Item& item) const noexcept;
+
     void Dispose() noexcept override;
 
   protected:
     void SetupParseFrom(Item& item);
+    void Dump_(Sink& sink) const override;
+    void GetMemoryUsage_(MemoryUsage& mu) const override;
 
   private:
     friend class Item;
@@ -66,6 +91,11 @@ namespace Neptools
     // properties needed: sorted
     using PointerMap = std::map<FilePosition, Item*>;
     PointerMap pmap;
+
+    XrefIndex& GetXref();
+    std::unique_ptr<XrefIndex> xref;
+    // see Item::MarkXrefVolatile
+    std::unordered_set<Item*> xref_volatile;
   };
 
   struct PrintLabelStruct { const Label* label; };
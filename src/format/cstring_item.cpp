@@ -1,5 +1,6 @@
 #include "cstring_item.hpp"
 #include "raw_item.hpp"
+#include "../memory_usage.hpp"
 #include "../sink.hpp"
 
 #include <libshit/char_utils.hpp>
@@ -28,6 +29,12 @@ namespace Neptools
     os << "c_string(" << Libshit::Quoted(string) << ')';
   }
 
+  void CStringItem::GetMemoryUsage_(MemoryUsage& mu) const
+  {
+    Item::GetMemoryUsage_(mu);
+    mu.AddString(string);
+  }
+
   std::string CStringItem::GetLabelName(std::string string)
   {
     size_t iptr = 0, optr = 0;
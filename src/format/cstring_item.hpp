@@ -26,6 +26,7 @@ namespace Neptools
   private:
     void Dump_(Sink& sink) const override;
     void Inspect_(std::ostream& os, unsigned indent) const override;
+    void GetMemoryUsage_(MemoryUsage& mu) const override;
   };
 
 }
@@ -1,33 +1,42 @@
 #include "gbnl_lua.hpp"
+#include "../memory_usage.hpp"
 #include "../open.hpp"
 #include "../sink.hpp"
+#include "../sjis.hpp"
+#include "../trace.hpp"
 
 #include <libshit/except.hpp>
 #include <libshit/char_utils.hpp>
 
-#include <map>
+#include <algorithm>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/container/small_vector.hpp>
 #include <boost/preprocessor/repetition/repeat.hpp>
 #include <brigand/algorithms/wrap.hpp>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+
+#include <libshit/doctest.hpp>
 
 namespace Neptools
 {
   static constexpr bool STRTOOL_COMPAT = false;
 
   namespace { enum class Separator { AUTO, SJIS, UTF8 }; }
-  static Separator export_sep = Separator::AUTO;
+  static Separator txt_encoding = Separator::AUTO;
 
   static Libshit::Option sep_opt{
     GetFlavorOptions(), "txt-encoding", 1, "ENCODING",
-    "Set exported txt encoding of .cl3/.gbin/.gstr files: "
-    "auto, sjis (Shift-JIS) or utf8",
+    "Set txt encoding of .cl3/.gbin/.gstr files on export and import: "
+    "auto (same as the file), sjis (Shift-JIS) or utf8. Strings are converted "
+    "when it differs from the file's encoding",
     [](auto&& args)
     {
-      if (strcmp(args.front(), "auto") == 0) export_sep = Separator::AUTO;
-      else if (strcmp(args.front(), "sjis") == 0) export_sep = Separator::SJIS;
-      else if (strcmp(args.front(), "utf8") == 0) export_sep = Separator::UTF8;
+      if (strcmp(args.front(), "auto") == 0) txt_encoding = Separator::AUTO;
+      else if (strcmp(args.front(), "sjis") == 0) txt_encoding = Separator::SJIS;
+      else if (strcmp(args.front(), "utf8") == 0) txt_encoding = Separator::UTF8;
       else throw Libshit::InvalidParam{"invalid argument"};
     }};
 
@@ -50,32 +59,6 @@ namespace Neptools
 #undef VALIDATE
   }
 
-  void endian_reverse_inplace(Gbnl::Header& hdr)
-  {
-    boost::endian::endian_reverse_inplace(hdr.field_04);
-    boost::endian::endian_reverse_inplace(hdr.field_06);
-    boost::endian::endian_reverse_inplace(hdr.field_08);
-    boost::endian::endian_reverse_inplace(hdr.field_0c);
-    boost::endian::endian_reverse_inplace(hdr.flags);
-    boost::endian::endian_reverse_inplace(hdr.descr_offset);
-    boost::endian::endian_reverse_inplace(hdr.count_msgs);
-    boost::endian::endian_reverse_inplace(hdr.msg_descr_size);
-    boost::endian::endian_reverse_inplace(hdr.count_types);
-    boost::endian::endian_reverse_inplace(hdr.offset_types);
-    boost::endian::endian_reverse_inplace(hdr.field_28);
-    boost::endian::endian_reverse_inplace(hdr.offset_msgs);
-    boost::endian::endian_reverse_inplace(hdr.field_30);
-    boost::endian::endian_reverse_inplace(hdr.field_34);
-    boost::endian::endian_reverse_inplace(hdr.field_38);
-    boost::endian::endian_reverse_inplace(hdr.field_3c);
-  }
-
-  void endian_reverse_inplace(Gbnl::TypeDescriptor& desc)
-  {
-    boost::endian::endian_reverse_inplace(desc.type);
-    boost::endian::endian_reverse_inplace(desc.offset);
-  }
-
   static size_t GetTypeSize(uint16_t type)
   {
     switch (type)
@@ -92,11 +75,13 @@ namespace Neptools
 
   Gbnl::Gbnl(Source src)
   {
+    Stats::PhaseTimer t{Stats::Phase::PARSE};
     ADD_SOURCE(Parse_(src), src);
   }
 
   void Gbnl::Parse_(Source& src)
   {
+    Trace::Scope tr{"Gbnl::Parse_"};
 #define VALIDATE(msg, x) LIBSHIT_VALIDATE_FIELD("Gbnl" msg, x)
 
     src.CheckSize(sizeof(Header));
@@ -116,7 +101,7 @@ namespace Neptools
     field_28 = foot.field_28;
     field_30 = foot.field_30;
 
-    src.Seek(foot.offset_types);
+    SourceCursor cur{src, foot.offset_types};
     msg_descr_size = foot.msg_descr_size;
     size_t calc_offs = 0;
 
@@ -124,7 +109,7 @@ namespace Neptools
     bool int8_in_progress = false;
     for (size_t i = 0; i < foot.count_types; ++i)
     {
-      auto type = src.ReadGen<TypeDescriptor>();
+      auto type = cur.ReadGen<TypeDescriptor>();
       ToNative(type, endian);
       VALIDATE("unordered types", calc_offs <= type.offset);
 
@@ -160,61 +145,69 @@ namespace Neptools
 
     type = bld.Build();
 
+    // strings are read after the descriptors, so the cursor stays valid
+    std::vector<std::pair<OffsetString*, FilePosition>> strs;
     auto msgs = foot.descr_offset;
     messages.reserve(foot.count_msgs);
+    Struct::NewArray(type, foot.count_msgs, [&](auto m)
+                     { messages.emplace_back(std::move(m)); });
     for (size_t i = 0; i < foot.count_msgs; ++i)
     {
-      messages.emplace_back(Struct::New(type));
-      auto& m = messages.back();
-      src.Seek(msgs);
+      auto& m = messages[i];
+      cur.Seek(msgs);
       for (size_t i = 0; i < type->item_count; ++i)
       {
         switch (type->items[i].idx)
         {
         case Struct::GetIndexFromType<int8_t>():
-          m->Get<int8_t>(i) = src.ReadUint8(endian);
+          m->Get<int8_t>(i) = cur.ReadUint8(endian);
           break;
         case Struct::GetIndexFromType<int16_t>():
-          m->Get<int16_t>(i) = src.ReadUint16(endian);
+          m->Get<int16_t>(i) = cur.ReadUint16(endian);
           break;
         case Struct::GetIndexFromType<int32_t>():
-          m->Get<int32_t>(i) = src.ReadUint32(endian);
+          m->Get<int32_t>(i) = cur.ReadUint32(endian);
           break;
         case Struct::GetIndexFromType<int64_t>():
-          m->Get<int64_t>(i) = src.ReadUint64(endian);
+          m->Get<int64_t>(i) = cur.ReadUint64(endian);
           break;
         case Struct::GetIndexFromType<float>():
         {
           union { float f; uint32_t i; } x;
-          x.i = src.ReadUint32(endian);
+          x.i = cur.ReadUint32(endian);
           m->Get<float>(i) = x.f;
           break;
         }
         case Struct::GetIndexFromType<OffsetString>():
         {
-          uint32_t offs = src.ReadUint32(endian);
+          uint32_t offs = cur.ReadUint32(endian);
           if (offs == 0xffffffff)
             m->Get<OffsetString>(i).offset = -1;
           else
           {
             VALIDATE("", offs < src.GetSize() - foot.offset_msgs);
-            auto str = foot.offset_msgs + offs;
-
-            m->Get<OffsetString>(i) = {src.PreadCString(str), 0};
+            strs.emplace_back(&m->Get<OffsetString>(i),
+                              foot.offset_msgs + offs);
           }
           break;
         }
         case Struct::GetIndexFromType<FixStringTag>():
-          src.Read(m->Get<FixStringTag>(i).str, type->items[i].size);
+          cur.Read(m->Get<FixStringTag>(i).str, type->items[i].size);
           break;
         case Struct::GetIndexFromType<PaddingTag>():
-          src.Read(m->Get<PaddingTag>(i).pad, type->items[i].size);
+          cur.Read(m->Get<PaddingTag>(i).pad, type->items[i].size);
           break;
         }
       }
 
       msgs += msg_descr_size;
     }
+
+    // in file order, so chunks are read sequentially
+    std::sort(strs.begin(), strs.end(), [](const auto& a, const auto& b)
+              { return a.second < b.second; });
+    for (const auto& [str, offs] : strs)
+      *str = {src.PreadCString(offs), 0};
     RecalcSize();
 
     VALIDATE(" invalid size after repack", msg_descr_size == foot.msg_descr_size);
@@ -304,6 +297,7 @@ namespace Neptools
 
   void Gbnl::Dump_(Sink& sink) const
   {
+    Trace::Scope tr{"Gbnl::Dump_"};
     if (is_gstl) DumpHeader(sink);
 
     // RB2-3 scripts: 36
@@ -371,6 +365,7 @@ namespace Neptools
     auto control_end_round = Align(control_end);
     sink.Pad(control_end_round - control_end);
 
+    // strings are laid out in order of their first use, see RecalcSize
     size_t offset = 0;
     for (const auto& m : messages)
       for (size_t i = 0; i < m->GetSize(); ++i)
@@ -451,6 +446,27 @@ namespace Neptools
     os << "neptools.";
     InspectGbnl(os, indent);
   }
+
+  void Gbnl::GetGbnlMemoryUsage(MemoryUsage& mu) const
+  {
+    mu.Add("Gbnl rows", messages.capacity() * sizeof(StructPtr), 0);
+    for (const auto& m : messages)
+    {
+      // rows parsed from a file share one block, count it once
+      size_t size;
+      auto block = m->GetAllocation(size);
+      mu.Add("Gbnl rows", mu.FirstSeen(block) ? size : 0);
+      for (size_t i = 0; i < m->GetSize(); ++i)
+        if (m->Is<OffsetString>(i))
+          mu.AddString(m->Get<OffsetString>(i).str);
+    }
+  }
+
+  void Gbnl::GetMemoryUsage_(MemoryUsage& mu) const
+  {
+    mu.AddObject(typeid(*this), sizeof(*this));
+    GetGbnlMemoryUsage(mu);
+  }
   void Gbnl::InspectGbnl(std::ostream& os, unsigned indent) const
   {
     os << "gbnl(neptools.endian." << ToString(endian) << ", "
@@ -493,6 +509,8 @@ namespace Neptools
 
   void Gbnl::RecalcSize()
   {
+    Trace::Scope tr{"Gbnl::RecalcSize"};
+    Stats::PhaseTimer t{Stats::Phase::FIXUP};
     size_t len = 0, count = 0;
     for (size_t i = 0; i < type->item_count; ++i)
       switch (type->items[i].idx)
@@ -511,8 +529,14 @@ namespace Neptools
     msg_descr_size = len;
     real_item_count = count;
 
-    std::map<std::string, size_t> offset_map;
-    size_t offset = 0;
+    // only referenced strings, in order of their first use, duplicates
+    // stored once. Unchanged strings keep their offsets as long as nothing
+    // before them changes, and the layout doesn't depend on earlier calls, so
+    // an imported file dumps the same as a freshly created one.
+    // keys point into the messages' strings, nothing is copied
+    std::unordered_map<std::string_view, uint32_t> offsets;
+    offsets.reserve(messages.size());
+    uint32_t offset = 0;
     for (auto& m : messages)
     {
       LIBSHIT_ASSERT(m->GetType() == type);
@@ -521,10 +545,9 @@ namespace Neptools
         {
           auto& os = m->Get<OffsetString>(i);
           if (os.offset == static_cast<uint32_t>(-1)) continue;
-          auto x = offset_map.emplace(os.str, offset);
-          if (x.second) // new item inserted
-            offset += os.str.size() + 1;
-          os.offset = x.first->second;
+          auto [it, inserted] = offsets.try_emplace(os.str, offset);
+          if (inserted) offset += os.str.size() + 1;
+          os.offset = it->second;
         }
     }
     msgs_size = offset;
@@ -591,10 +614,23 @@ namespace Neptools
       return this_k*10000+j;
   }
 
+  // convert str between the txt's and the file's encoding
+  static void ConvertTxt(std::string& str, bool from_utf8, bool to_utf8)
+  {
+    if (from_utf8 == to_utf8) return;
+    str = to_utf8 ? Sjis::ToUtf8(str) : Sjis::FromUtf8(str);
+  }
+
+  static bool IsTxtUtf8(bool file_utf8) noexcept
+  {
+    return txt_encoding == Separator::UTF8 ||
+      (txt_encoding == Separator::AUTO && file_utf8);
+  }
+
   void Gbnl::WriteTxt_(std::ostream& os) const
   {
-    bool utf8 = export_sep == Separator::UTF8 ||
-      (export_sep == Separator::AUTO && field_30 == 8);
+    bool file_utf8 = field_30 == 8;
+    bool utf8 = IsTxtUtf8(file_utf8);
     auto sep = utf8 ? SEP_DASH_UTF8 : SEP_DASH;
     size_t j = 0;
     for (const auto& m : messages)
@@ -611,6 +647,7 @@ namespace Neptools
           else
             str = m->Get<OffsetString>(i).str;
           boost::replace_all(str, "\n", "\r\n");
+          ConvertTxt(str, file_utf8, utf8);
 
           if constexpr (STRTOOL_COMPAT)
             boost::replace_all(str, "#n", "\r\n");
@@ -654,6 +691,9 @@ namespace Neptools
   {
     std::string line, msg;
     size_t last_index = 0, pos = -1;
+    // the txt's encoding comes from --txt-encoding, not from the separator:
+    // older versions wrote UTF-8 separators around unconverted strings
+    bool file_utf8 = field_30 == 8, utf8 = IsTxtUtf8(file_utf8);
 
     while (is.good())
     {
@@ -669,6 +709,11 @@ namespace Neptools
         {
           LIBSHIT_ASSERT(msg.empty() || msg.back() == '\n');
           if (!msg.empty()) msg.pop_back();
+          LIBSHIT_ADD_INFOS(
+            ConvertTxt(msg, utf8, file_utf8),
+            "Txt encoding", utf8 ? "utf8" : "sjis",
+            "Note", "txt files exported by older versions are not converted, "
+            "import them with --txt-encoding auto");
           auto& m = messages[last_index];
           if (m->Is<OffsetString>(pos))
             m->Get<OffsetString>(pos).str = std::move(msg);
@@ -718,6 +763,184 @@ namespace Neptools
       return nullptr;
     }};
 
+  TEST_SUITE_BEGIN("Neptools::Gbnl");
+
+  static std::string DumpToString(Dumpable& d)
+  {
+    d.Fixup();
+    std::string ret(d.GetSize(), '\0');
+    d.Dump(MemorySink{reinterpret_cast<Byte*>(ret.data()),
+                      FileMemSize(ret.size())});
+    return ret;
+  }
+
+  // {int32 id, string} messages
+  static Libshit::NotNull<Libshit::SmartPtr<Gbnl>> MakeTestGbnl(
+    std::initializer_list<const char*> strs)
+  {
+    Gbnl::Struct::TypeBuilder bld;
+    bld.Add<int32_t>();
+    bld.Add<Gbnl::OffsetString>();
+    auto gbnl = Libshit::MakeSmart<Gbnl>(
+      Endian::LITTLE, false, 1, 0, 0, bld.Build());
+    int32_t id = 0;
+    for (auto str : strs)
+    {
+      auto m = Gbnl::Struct::New(gbnl->type);
+      m->Get<int32_t>(0) = id++;
+      m->Get<Gbnl::OffsetString>(1) = {str, 0};
+      gbnl->messages.emplace_back(std::move(m));
+    }
+    gbnl->Fixup();
+    return gbnl;
+  }
+
+  TEST_CASE("rows outlive the parsed file")
+  {
+    auto data = DumpToString(*MakeTestGbnl({"foo", "bar", "asd"}));
+    Libshit::SmartPtr<Gbnl> copy;
+    {
+      Libshit::SmartPtr<Gbnl> gbnl =
+        Libshit::MakeSmart<Gbnl>(Source::FromMemory(data));
+      REQUIRE(gbnl->messages.size() == 3);
+
+      // every parsed row is in one block, counted once
+      size_t size0, size1;
+      auto block = gbnl->messages[0]->GetAllocation(size0);
+      CHECK(gbnl->messages[1]->GetAllocation(size1) == block);
+      CHECK(size0 == size1);
+      CHECK(size0 >= 3 * (sizeof(Gbnl::Struct) - 1 + gbnl->type->byte_size));
+
+      MemoryUsage mu;
+      gbnl->GetMemoryUsage(mu);
+      auto& rows = mu.GetEntries().at("Gbnl rows");
+      CHECK(rows.count == 3);
+      CHECK(rows.bytes ==
+            size0 + gbnl->messages.capacity() * sizeof(Gbnl::StructPtr));
+
+      // copy rows out to a new file, keep one row alone, drop the parsed file
+      copy = Libshit::MakeSmart<Gbnl>(
+        Endian::LITTLE, false, 1, 0, 0, gbnl->type);
+      copy->messages.push_back(gbnl->messages[2]);
+      copy->messages.push_back(gbnl->messages[0]);
+      Gbnl::StructPtr row = gbnl->messages[1];
+      gbnl->messages.clear();
+      gbnl.reset();
+
+      CHECK(row->Get<Gbnl::OffsetString>(1).str == "bar");
+      row->Get<Gbnl::OffsetString>(1).str = "longer than a short string buffer";
+    }
+
+    auto copy2 = Libshit::MakeSmart<Gbnl>(
+      Source::FromMemory(DumpToString(*copy)));
+    copy.reset();
+    REQUIRE(copy2->messages.size() == 2);
+    CHECK(copy2->messages[0]->Get<int32_t>(0) == 2);
+    CHECK(copy2->messages[0]->Get<Gbnl::OffsetString>(1).str == "asd");
+    CHECK(copy2->messages[1]->Get<int32_t>(0) == 0);
+    CHECK(copy2->messages[1]->Get<Gbnl::OffsetString>(1).str == "foo");
+  }
+
+  static uint32_t GetOffset(const Gbnl& gbnl, size_t i)
+  { return gbnl.messages[i]->Get<Gbnl::OffsetString>(1).offset; }
+  static void SetString(Gbnl& gbnl, size_t i, const char* str)
+  { gbnl.messages[i]->Get<Gbnl::OffsetString>(1).str = str; }
+
+  TEST_CASE("imported file dumps like a fresh one")
+  {
+    auto data = DumpToString(*MakeTestGbnl({"foo", "bar", "foo", "", "asd"}));
+    auto gbnl = Libshit::MakeSmart<Gbnl>(Source::FromMemory(data));
+    CHECK(DumpToString(*gbnl) == data);
+
+    // replaced strings are not kept around
+    SetString(*gbnl, 1, "a much longer string");
+    SetString(*gbnl, 4, "x");
+    CHECK(DumpToString(*gbnl) == DumpToString(*MakeTestGbnl(
+            {"foo", "a much longer string", "foo", "", "x"})));
+    SetString(*gbnl, 1, "bar");
+    SetString(*gbnl, 4, "asd");
+    CHECK(DumpToString(*gbnl) == data);
+  }
+
+  TEST_CASE("string offsets")
+  {
+    auto gbnl = MakeTestGbnl({"foo", "bar", "foo", "asd", "bar"});
+    uint32_t exp[] = {0, 4, 0, 8, 4};
+    for (size_t i = 0; i < std::size(exp); ++i)
+    {
+      CAPTURE(i);
+      CHECK(GetOffset(*gbnl, i) == exp[i]);
+    }
+
+    // unchanged strings keep their offsets
+    gbnl->RecalcSize();
+    SetString(*gbnl, 3, "a longer string");
+    gbnl->RecalcSize();
+    SetString(*gbnl, 1, "baz");
+    gbnl->RecalcSize();
+    uint32_t exp2[] = {0, 4, 0, 8, 24};
+    for (size_t i = 0; i < std::size(exp2); ++i)
+    {
+      CAPTURE(i);
+      CHECK(GetOffset(*gbnl, i) == exp2[i]);
+    }
+    CHECK(gbnl->GetSize() == DumpToString(*gbnl).size());
+  }
+
+  TEST_CASE("txt round trip")
+  {
+    // "テスト表": the last kanji ends in '\\' in Shift-JIS
+    const char* sjis = "\x83\x65\x83\x58\x83\x67\x95\x5cn\nbar";
+    const char* utf8 =
+      "\xe3\x83\x86\xe3\x82\xb9\xe3\x83\x88\xe8\xa1\xa8n\nbar";
+    for (bool file_utf8 : {false, true})
+      for (auto sep : {Separator::AUTO, Separator::SJIS, Separator::UTF8})
+      {
+        CAPTURE(file_utf8); CAPTURE(static_cast<int>(sep));
+        auto gbnl = MakeTestGbnl({"foo", file_utf8 ? utf8 : sjis, ""});
+        if (file_utf8) gbnl->field_30 = 8;
+        auto data = DumpToString(*gbnl);
+
+        std::stringstream ss;
+        txt_encoding = sep;
+        gbnl->WriteTxt(ss);
+        bool txt_utf8 = sep == Separator::UTF8 ||
+          (sep == Separator::AUTO && file_utf8);
+        std::string exp = txt_utf8 ? utf8 : sjis;
+        boost::replace_all(exp, "\n", "\r\n");
+        CHECK(ss.str().find(exp) != std::string::npos);
+
+        for (size_t i = 0; i < 3; ++i) SetString(*gbnl, i, "x");
+        gbnl->ReadTxt(ss);
+        txt_encoding = Separator::AUTO;
+        CHECK(DumpToString(*gbnl) == data);
+      }
+  }
+
+  TEST_CASE("import unconverted txt")
+  {
+    // older versions only changed the separator with --txt-encoding utf8
+    auto gbnl = MakeTestGbnl({"foo", "\x83\x65\x83\x58\x83\x67", ""});
+    auto data = DumpToString(*gbnl);
+    std::stringstream ss;
+    gbnl->WriteTxt(ss);
+    auto txt = ss.str();
+    boost::replace_all(
+      txt, std::string(SEP_DASH.data(), SEP_DASH.size()),
+      std::string(SEP_DASH_UTF8.data(), SEP_DASH_UTF8.size()));
+
+    SetString(*gbnl, 1, "x");
+    std::stringstream ss2{txt};
+    gbnl->ReadTxt(ss2);
+    CHECK(DumpToString(*gbnl) == data);
+
+    txt_encoding = Separator::UTF8;
+    std::stringstream ss3{txt};
+    CHECK_THROWS_AS(gbnl->ReadTxt(ss3), Libshit::DecodeError);
+    txt_encoding = Separator::AUTO;
+  }
+
+  TEST_SUITE_END();
 }
 
 #include <libshit/container/vector.lua.hpp>
@@ -10,6 +10,7 @@
 
 #include <libshit/lua/auto_table.hpp>
 #include <boost/endian/arithmetic.hpp>
+#include <string>
 #include <vector>
 
 namespace Neptools
@@ -111,6 +112,9 @@ namespace Neptools
     void Dump_(Sink& sink) const override;
     void InspectGbnl(std::ostream& os, unsigned indent) const;
     void Inspect_(std::ostream& os, unsigned indent) const override;
+    // rows and strings, without the Gbnl object itself
+    void GetGbnlMemoryUsage(MemoryUsage& mu) const;
+    void GetMemoryUsage_(MemoryUsage& mu) const override;
 
   private:
     void WriteTxt_(std::ostream& os) const override;
@@ -129,7 +133,10 @@ namespace Neptools
     size_t real_item_count; // excluding dummy pad items
   };
 
-  void endian_reverse_inplace(Gbnl::Header& hdr);
-  void endian_reverse_inplace(Gbnl::TypeDescriptor& desc);
+  NEPTOOLS_ENDIAN_FIELDS(
+    Gbnl::Header, field_04, field_06, field_08, field_0c, flags, descr_offset,
+    count_msgs, msg_descr_size, count_types, offset_types, field_28,
+    offset_msgs, field_30, field_34, field_38, field_3c);
+  NEPTOOLS_ENDIAN_FIELDS(Gbnl::TypeDescriptor, type, offset);
 }
 #endif
@@ -1,6 +1,8 @@
 #include "item.hpp"
 #include "context.hpp"
 #include "raw_item.hpp"
+#include "xref.hpp"
+#include "../memory_usage.hpp"
 #include "../utils.hpp"
 
 #include <libshit/char_utils.hpp>
@@ -62,10 +64,36 @@ namespace Neptools
     list.erase(self);
   }
 
+  void Item::CollectXrefs(XrefEntry&) const {}
+
+  void Item::XrefChanged() noexcept
+  {
+    if (auto ctx = GetContextMaybe()) ctx->UpdateXref(*this);
+  }
+
+  void Item::MarkXrefVolatile()
+  {
+    auto ctx = GetContextMaybe();
+    if (ctx && ctx->IsAttached(*this)) ctx->xref_volatile.insert(this);
+  }
+
+  void Item::Added(ItemList& list) noexcept
+  {
+    auto ctx = GetContextMaybe();
+    if (!ctx || !ctx->xref) return;
+    // parent link might not be set yet
+    auto& parent = static_cast<ItemWithChildren&>(list);
+    if (&parent != ctx.get() && !ctx->IsAttached(parent)) return;
+    try { ctx->xref->Add(*this); }
+    catch (...) { ctx->xref.reset(); } // rebuild on next query
+  }
+
   void Item::Removed()
   {
     auto ctx = GetContextMaybe();
     if (!ctx) return;
+    if (ctx->xref) ctx->xref->Remove(*this);
+    ctx->xref_volatile.erase(this);
     auto it = ctx->pmap.find(position);
     if (it != ctx->pmap.end() && it->second == this)
       ctx->pmap.erase(it);
@@ -140,12 +168,24 @@ namespace Neptools
     return os;
   }
 
+  void Item::GetMemoryUsage_(MemoryUsage& mu) const
+  {
+    mu.AddObject(typeid(*this), sizeof(Item));
+  }
+
   void ItemWithChildren::Dump_(Sink& sink) const
   {
     for (auto& c : GetChildren())
       c.Dump(sink);
   }
 
+  void ItemWithChildren::GetMemoryUsage_(MemoryUsage& mu) const
+  {
+    Item::GetMemoryUsage_(mu);
+    for (auto& c : GetChildren())
+      c.GetMemoryUsage(mu);
+  }
+
   void ItemWithChildren::InspectChildren(std::ostream& os, unsigned indent) const
   {
     if (GetChildren().empty()) return;
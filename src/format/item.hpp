@@ -20,6 +20,7 @@ namespace Neptools
 
   class ItemWithChildren;
   struct ItemListTraits;
+  struct XrefEntry;
 
   LIBSHIT_GEN_EXCEPTION_TYPE(InvalidItemState, std::logic_error);
 
@@ -92,10 +93,21 @@ namespace Neptools
 
     void Dispose() noexcept override;
 
+    // Append labels/opcode this item refers to. Override this when the item
+    // stores references (and call XrefChanged when they change).
+    LIBSHIT_NOLUA virtual void CollectXrefs(XrefEntry& entry) const;
+    // Update the context's cross reference index after a change.
+    LIBSHIT_NOLUA void XrefChanged() noexcept;
+    // The references can change without the item knowing (e.g. a container of
+    // them was handed out to lua): re-collect them before every query while
+    // the item is in its context.
+    LIBSHIT_NOLUA void MarkXrefVolatile();
+
   protected:
     void UpdatePosition(FilePosition npos);
 
     void Inspect_(std::ostream& os, unsigned indent) const override = 0;
+    void GetMemoryUsage_(MemoryUsage& mu) const override;
 
     using SlicePair = std::pair<Libshit::NotNull<
                                   Libshit::RefCountedPtr<Item>>, FilePosition>;
@@ -110,6 +122,7 @@ namespace Neptools
     LabelsContainer labels;
 
     void Replace_(const Libshit::NotNull<Libshit::RefCountedPtr<Item>>& nitem);
+    void Added(Libshit::ParentList<Item, ItemListTraits>& list) noexcept;
     virtual void Removed();
 
     friend class Context;
@@ -127,8 +140,8 @@ namespace Neptools
   using ItemList = Libshit::ParentList<Item, ItemListTraits>;
   struct ItemListTraits
   {
-    static void add(ItemList&, Item& item) noexcept
-    { item.AddRef(); }
+    static void add(ItemList& list, Item& item) noexcept
+    { item.AddRef(); item.Added(list); }
     static void remove(ItemList&, Item& item) noexcept
     { item.Removed(); item.RemoveRef(); }
   };
@@ -158,6 +171,7 @@ namespace Neptools
   protected:
     void Dump_(Sink& sink) const override;
     void InspectChildren(std::ostream& sink, unsigned indent) const;
+    void GetMemoryUsage_(MemoryUsage& mu) const override;
     void Fixup_(FilePosition offset);
 
   private:
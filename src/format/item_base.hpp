@@ -2,6 +2,7 @@
 #define UUID_02043882_EC07_4CCA_BD13_1BB9F5C7DB9F
 #pragma once
 
+#include "../stats.hpp"
 #include "../utils.hpp"
 
 #include <libshit/assert.hpp>
@@ -87,7 +88,8 @@ namespace Neptools LIBSHIT_META("alias_file src/format/item.hpp")
   public:
 
     Label(std::string name, ItemPointer ptr)
-      : name{std::move(name)}, ptr{ptr} {}
+      : name{std::move(name)}, ptr{ptr}
+    { Stats::Add(Stats::Counter::LABELS_CREATED); }
 
     const std::string& GetName() const { return name; }
     const ItemPointer& GetPtr() const { return ptr; }
@@ -1,5 +1,6 @@
 #include "raw_item.hpp"
 #include "context.hpp"
+#include "../memory_usage.hpp"
 #include <iomanip>
 
 namespace Neptools
@@ -16,6 +17,12 @@ namespace Neptools
     os << "raw(" << Quoted(src) << ")";
   }
 
+  void RawItem::GetMemoryUsage_(MemoryUsage& mu) const
+  {
+    Item::GetMemoryUsage_(mu);
+    src.GetMemoryUsage(mu);
+  }
+
   Libshit::NotNull<Libshit::RefCountedPtr<RawItem>> RawItem::InternalSlice(
     FilePosition spos, FilePosition slen)
   {
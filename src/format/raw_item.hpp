@@ -77,6 +77,7 @@ namespace Neptools
 
     void Dump_(Sink& sink) const override;
     void Inspect_(std::ostream& os, unsigned indent) const override;
+    void GetMemoryUsage_(MemoryUsage& mu) const override;
 
     Source src;
   };
@@ -3,7 +3,9 @@
 #include "../cstring_item.hpp"
 #include "../eof_item.hpp"
 #include "../raw_item.hpp"
+#include "../../memory_usage.hpp"
 #include "../../sink.hpp"
+#include "../../trace.hpp"
 
 #include <libshit/container/vector.lua.hpp>
 
@@ -46,6 +48,7 @@ namespace Neptools::Stcm
   CollectionLinkHeaderItem& CollectionLinkHeaderItem::CreateAndInsert(
     ItemPointer ptr)
   {
+    Trace::Scope tr{"Stcm::CollectionLinkHeaderItem::CreateAndInsert"};
     auto x = RawItem::Get<Header>(ptr);
     auto& ret = x.ritem.SplitCreate<CollectionLinkHeaderItem>(ptr.offset, x.t);
 
@@ -153,6 +156,12 @@ namespace Neptools::Stcm
     Indent(os, indent) << "}";
   }
 
+  void CollectionLinkItem::GetMemoryUsage_(MemoryUsage& mu) const
+  {
+    Item::GetMemoryUsage_(mu);
+    mu.AddExtra(typeid(*this), entries.capacity() * sizeof(LinkEntry));
+  }
+
 }
 
 LIBSHIT_STD_VECTOR_LUAGEN(
@@ -2,6 +2,7 @@
 #include "../context.hpp"
 #include "../raw_item.hpp"
 #include "../../sink.hpp"
+#include "../../trace.hpp"
 #include <iostream>
 
 namespace Neptools::Stcm
@@ -27,6 +28,7 @@ namespace Neptools::Stcm
 
   DataItem& DataItem::CreateAndInsert(ItemPointer ptr)
   {
+    Trace::Scope tr{"Stcm::DataItem::CreateAndInsert"};
     auto x = RawItem::Get<Header>(ptr);
 
     auto& ret = x.ritem.SplitCreate<DataItem>(
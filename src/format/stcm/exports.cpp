@@ -3,7 +3,11 @@
 #include "header.hpp"
 #include "instruction.hpp"
 #include "../context.hpp"
+#include "../xref.hpp"
+#include "../xref.lua.hpp"
+#include "../../memory_usage.hpp"
 #include "../../sink.hpp"
+#include "../../trace.hpp"
 
 #include <libshit/char_utils.hpp>
 #include <libshit/container/vector.lua.hpp>
@@ -46,6 +50,7 @@ namespace Neptools::Stcm
   ExportsItem& ExportsItem::CreateAndInsert(
     ItemPointer ptr, uint32_t export_count)
   {
+    Trace::Scope tr{"Stcm::ExportsItem::CreateAndInsert"};
     auto x = RawItem::GetSource(ptr, export_count*sizeof(Entry));
 
     auto& ret = x.ritem.SplitCreate<ExportsItem>(
@@ -70,6 +75,11 @@ namespace Neptools::Stcm
     Item::Dispose();
   }
 
+  void ExportsItem::CollectXrefs(XrefEntry& entry) const
+  {
+    for (const auto& e : entries) entry.Add(&*e->lbl);
+  }
+
   void ExportsItem::Dump_(Sink& sink) const
   {
     Entry ee;
@@ -97,6 +107,13 @@ namespace Neptools::Stcm
     Indent(os, indent) << '}';
   }
 
+  void ExportsItem::GetMemoryUsage_(MemoryUsage& mu) const
+  {
+    Item::GetMemoryUsage_(mu);
+    mu.AddExtra(typeid(*this), entries.capacity() * sizeof(VectorEntry) +
+                entries.size() * sizeof(EntryType));
+  }
+
 }
 
 LIBSHIT_STD_VECTOR_LUAGEN(
@@ -56,14 +56,16 @@ namespace Neptools::Stcm
     FilePosition GetSize() const noexcept override
     { return sizeof(Entry) * entries.size(); }
 
-    LIBSHIT_LUAGEN(get="::Libshit::Lua::GetSmartOwnedMember")
+    LIBSHIT_LUAGEN(get="::Neptools::GetXrefMember")
     std::vector<VectorEntry> entries;
 
     void Dispose() noexcept override;
+    LIBSHIT_NOLUA void CollectXrefs(XrefEntry& entry) const override;
 
   private:
     void Dump_(Sink& sink) const override;
     void Inspect_(std::ostream& os, unsigned indent) const override;
+    void GetMemoryUsage_(MemoryUsage& mu) const override;
     void Parse_(Context& ctx, Source& src, uint32_t export_count);
 };
 
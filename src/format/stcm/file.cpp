@@ -4,17 +4,20 @@
 #include "../eof_item.hpp"
 #include "../item.hpp"
 #include "../../open.hpp"
+#include "../../trace.hpp"
 
 namespace Neptools::Stcm
 {
 
   File::File(Source src)
   {
+    Stats::PhaseTimer t{Stats::Phase::PARSE};
     ADD_SOURCE(Parse_(src), src);
   }
 
   void File::Parse_(Source& src)
   {
+    Trace::Scope tr{"Stcm::File::Parse_"};
     auto root = Create<RawItem>(src);
     SetupParseFrom(*root);
     root->Split(root->GetSize(), Create<EofItem>());
@@ -3,6 +3,7 @@
 #include "../context.hpp"
 #include "../gbnl_lua.hpp"
 #include "../raw_item.hpp"
+#include "../../trace.hpp"
 
 #include <libshit/container/vector.lua.hpp>
 
@@ -19,6 +20,7 @@ namespace Neptools::Stcm
 
   GbnlItem& GbnlItem::CreateAndInsert(ItemPointer ptr)
   {
+    Trace::Scope tr{"Stcm::GbnlItem::CreateAndInsert"};
     auto x = RawItem::GetSource(ptr, -1);
     return x.ritem.SplitCreate<GbnlItem>(ptr.offset, x.src);
   }
@@ -53,6 +53,8 @@ namespace Neptools::Stcm
     void Dump_(Sink& sink) const override { Gbnl::Dump_(sink); }
     void Inspect_(std::ostream& os, unsigned indent) const override
     { Item::Inspect_(os, indent); Gbnl::InspectGbnl(os, indent); }
+    void GetMemoryUsage_(MemoryUsage& mu) const override
+    { Item::GetMemoryUsage_(mu); Gbnl::GetGbnlMemoryUsage(mu); }
   };
 
   inline Libshit::Lua::DynamicObject& GetDynamicObject(GbnlItem& item)
@@ -3,6 +3,7 @@
 #include "exports.hpp"
 #include "../context.hpp"
 #include "../../sink.hpp"
+#include "../../trace.hpp"
 #include "../../utils.hpp"
 
 #include <libshit/char_utils.hpp>
@@ -38,6 +39,7 @@ namespace Neptools::Stcm
 
   HeaderItem& HeaderItem::CreateAndInsert(ItemPointer ptr)
   {
+    Trace::Scope tr{"Stcm::HeaderItem::CreateAndInsert"};
     auto x = RawItem::Get<Header>(ptr);
 
     auto& ret = x.ritem.SplitCreate<HeaderItem>(ptr.offset, x.t);
@@ -53,7 +53,7 @@ namespace Libshit::Lua
       static_cast<void (::Neptools::Stcm::InstructionItem::*)(::Libshit::NotNull<::Neptools::LabelPtr>) noexcept>(&::Neptools::Stcm::InstructionItem::SetTarget)
     >("set_target");
     bld.AddFunction<
-      &::Libshit::Lua::GetSmartOwnedMember<::Neptools::Stcm::InstructionItem, std::vector<::Neptools::Stcm::InstructionItem::Param>, &::Neptools::Stcm::InstructionItem::params>
+      &::Neptools::GetXrefMember<::Neptools::Stcm::InstructionItem, std::vector<::Neptools::Stcm::InstructionItem::Param>, &::Neptools::Stcm::InstructionItem::params>
     >("get_params");
 
   }
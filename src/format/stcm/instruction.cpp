@@ -2,7 +2,11 @@
 #include "data.hpp"
 #include "../context.hpp"
 #include "../raw_item.hpp"
+#include "../xref.hpp"
+#include "../xref.lua.hpp"
+#include "../../memory_usage.hpp"
 #include "../../sink.hpp"
+#include "../../trace.hpp"
 
 #include <libshit/except.hpp>
 #include <libshit/container/vector.lua.hpp>
@@ -105,7 +109,8 @@ namespace Neptools::Stcm
 
   void InstructionItem::Parse_(Context& ctx, Source& src)
   {
-    auto instr = src.ReadGen<Header>();
+    SourceCursor cur{src};
+    auto instr = cur.ReadGen<Header>();
     instr.Validate(ctx.GetSize());
 
     if (instr.is_call)
@@ -116,9 +121,10 @@ namespace Neptools::Stcm
     params.reserve(instr.param_count);
     for (size_t i = 0; i < instr.param_count; ++i)
     {
-      auto p = src.ReadGen<Parameter>();
+      auto p = cur.ReadGen<Parameter>();
       params.emplace_back(ctx, p);
     }
+    src.Seek(cur.Tell());
   }
 
   auto InstructionItem::Param::GetVariant(Context& ctx, const Parameter& in)
@@ -307,6 +313,7 @@ namespace Neptools::Stcm
 
   InstructionItem& InstructionItem::CreateAndInsert(ItemPointer ptr)
   {
+    Trace::Scope tr{"Stcm::InstructionItem::CreateAndInsert"};
     auto x = RawItem::GetSource(ptr, -1);
 
     x.src.CheckSize(sizeof(Header));
@@ -385,6 +392,62 @@ namespace Neptools::Stcm
     ItemWithChildren::Dispose();
   }
 
+  void InstructionItem::SetOpcode(uint32_t oc) noexcept
+  {
+    opcode_target = oc;
+    XrefChanged();
+  }
+
+  void InstructionItem::SetTarget(Libshit::NotNull<LabelPtr> label) noexcept
+  {
+    opcode_target = label;
+    XrefChanged();
+  }
+
+  void InstructionItem::CollectXrefs(XrefEntry& entry) const
+  {
+    if (IsCall())
+      entry.Add(&*GetTarget(), XrefKind::CODE);
+    else
+      entry.opcode = GetOpcode();
+
+    auto add48 = [&](const Param48& p)
+    {
+      if (p.GetType() == Param48::Type::MEM_OFFSET)
+        entry.Add(&*p.Get<Param48::Type::MEM_OFFSET>());
+    };
+    for (const auto& p : params)
+    {
+      using T = Param::Type;
+      switch (p.GetType())
+      {
+      case T::MEM_OFFSET:
+      {
+        const auto& mo = p.Get<T::MEM_OFFSET>();
+        entry.Add(&*mo.target);
+        add48(mo.param_4);
+        add48(mo.param_8);
+        break;
+      }
+      case T::INDIRECT:
+        add48(p.Get<T::INDIRECT>().param_8);
+        break;
+      case T::INSTR_PTR0:
+        entry.Add(&*p.Get<T::INSTR_PTR0>(), XrefKind::CODE);
+        break;
+      case T::INSTR_PTR1:
+        entry.Add(&*p.Get<T::INSTR_PTR1>(), XrefKind::CODE);
+        break;
+      case T::COLL_LINK:
+        entry.Add(&*p.Get<T::COLL_LINK>());
+        break;
+      case T::READ_STACK:
+      case T::READ_4AC:
+        break;
+      }
+    }
+  }
+
   void InstructionItem::Dump_(Sink& sink) const
   {
     Header hdr;
@@ -424,6 +487,12 @@ namespace Neptools::Stcm
     InspectChildren(os, indent);
   }
 
+  void InstructionItem::GetMemoryUsage_(MemoryUsage& mu) const
+  {
+    ItemWithChildren::GetMemoryUsage_(mu);
+    mu.AddExtra(typeid(*this), params.capacity() * sizeof(Param));
+  }
+
 }
 
 LIBSHIT_STD_VECTOR_LUAGEN(
@@ -114,12 +114,13 @@ namespace Neptools::Stcm
 
     uint32_t GetOpcode() const { return std::get<0>(opcode_target); }
 
-    void SetOpcode(uint32_t oc) noexcept { opcode_target = oc; }
+    void SetOpcode(uint32_t oc) noexcept;
     Libshit::NotNull<LabelPtr> GetTarget() const
     { return std::get<1>(opcode_target); }
 
-    void SetTarget(Libshit::NotNull<LabelPtr> label) noexcept
-    { opcode_target = label; }
+    void SetTarget(Libshit::NotNull<LabelPtr> label) noexcept;
+
+    LIBSHIT_NOLUA void CollectXrefs(XrefEntry& entry) const override;
 
     class Param48 : public Libshit::Lua::ValueObject
     {
@@ -278,7 +279,7 @@ namespace Neptools::Stcm
       static Variant GetVariant(Context& ctx, const Parameter& in);
     } LIBSHIT_LUAGEN(post_register="bld.TaggedNew();");
 
-    LIBSHIT_LUAGEN(get="::Libshit::Lua::GetSmartOwnedMember")
+    LIBSHIT_LUAGEN(get="::Neptools::GetXrefMember")
     std::vector<Param> params;
 
   private:
@@ -286,6 +287,7 @@ namespace Neptools::Stcm
 
     void Dump_(Sink& sink) const override;
     void Inspect_(std::ostream& os, unsigned indent) const override;
+    void GetMemoryUsage_(MemoryUsage& mu) const override;
     void Parse_(Context& ctx, Source& src);
   };
 
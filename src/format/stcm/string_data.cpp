@@ -2,6 +2,7 @@
 
 #include "data.hpp"
 #include "../raw_item.hpp"
+#include "../../memory_usage.hpp"
 #include "../../sink.hpp"
 
 #include <libshit/char_utils.hpp>
@@ -56,6 +57,12 @@ namespace Neptools::Stcm
     os << "string_data(" << Libshit::Quoted(string) << ')';
   }
 
+  void StringDataItem::GetMemoryUsage_(MemoryUsage& mu) const
+  {
+    Item::GetMemoryUsage_(mu);
+    mu.AddString(string);
+  }
+
   static Stcm::DataFactory reg{[](DataItem& it) {
       return !!StringDataItem::MaybeCreateAndReplace(it); }};
 
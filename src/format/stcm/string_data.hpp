@@ -25,6 +25,7 @@ namespace Neptools::Stcm
   private:
     void Dump_(Sink& sink) const override;
     void Inspect_(std::ostream& os, unsigned indent) const override;
+    void GetMemoryUsage_(MemoryUsage& mu) const override;
   };
 
 }
@@ -4,19 +4,26 @@
 #include "../eof_item.hpp"
 #include "../raw_item.hpp"
 #include "../../open.hpp"
+#include "../../sjis.hpp"
+#include "../../trace.hpp"
 
 #include <boost/algorithm/string/replace.hpp>
+#include <sstream>
+
+#include <libshit/doctest.hpp>
 
 namespace Neptools::Stsc
 {
 
   File::File(Source src, Flavor flavor) : flavor{flavor}
   {
+    Stats::PhaseTimer t{Stats::Phase::PARSE};
     ADD_SOURCE(Parse_(src), src);
   }
 
   void File::Parse_(Source& src)
   {
+    Trace::Scope tr{"Stsc::File::Parse_"};
     auto root = Create<RawItem>(src);
     SetupParseFrom(*root);
     root->Split(root->GetSize(), Create<EofItem>());
@@ -36,6 +43,39 @@ namespace Neptools::Stsc
     '\r', 0,
   };
 
+  // strings in stsc files are always Shift-JIS
+  static bool txt_utf8 = false;
+  static Libshit::Option txt_encoding_opt{
+    GetFlavorOptions(), "stsc-txt-encoding", 1, "ENCODING",
+    "Set txt encoding of .bin (STSC) files: sjis (Shift-JIS, default) or utf8",
+    [](auto&& args)
+    {
+      if (strcmp(args.front(), "sjis") == 0) txt_utf8 = false;
+      else if (strcmp(args.front(), "utf8") == 0) txt_utf8 = true;
+      else throw Libshit::InvalidParam{"invalid argument"};
+    }};
+
+  // replace_all("\\n", "\r\n") that skips the second byte of double byte
+  // characters
+  static std::string ReplaceSjisNewlines(const std::string& str)
+  {
+    std::string ret;
+    ret.reserve(str.size());
+    for (size_t i = 0; i < str.size(); ++i)
+    {
+      if (Sjis::IsLeadByte(str[i]) && i + 1 < str.size())
+        ret.append(str, i++, 2);
+      else if (str[i] == '\\' && i + 1 < str.size() && str[i+1] == 'n')
+      {
+        ret.append("\r\n");
+        ++i;
+      }
+      else
+        ret.push_back(str[i]);
+    }
+    return ret;
+  }
+
   void File::WriteTxt_(std::ostream& os) const
   {
     for (auto& it : GetChildren())
@@ -43,8 +83,17 @@ namespace Neptools::Stsc
       auto str = dynamic_cast<const CStringItem*>(&it);
       if (str)
       {
-        os << boost::replace_all_copy(str->string, "\\n", "\r\n")
-           << "\r\n" << SEP_DASH << '\n';
+        std::string txt;
+        if (txt_utf8)
+        {
+          // convert first, in Shift-JIS "\\n" can be the end of a double
+          // byte character
+          txt = Sjis::ToUtf8(str->string);
+          boost::replace_all(txt, "\\n", "\r\n");
+        }
+        else
+          txt = ReplaceSjisNewlines(str->string);
+        os << txt << "\r\n" << SEP_DASH << '\n';
       }
     }
   }
@@ -66,7 +115,8 @@ namespace Neptools::Stsc
 
         LIBSHIT_ASSERT(msg.empty() || msg.substr(msg.length()-2) == "\\n");
         if (!msg.empty()) { msg.pop_back(); msg.pop_back(); }
-        static_cast<CStringItem&>(*it).string = std::move(msg);
+        static_cast<CStringItem&>(*it).string =
+          txt_utf8 ? Sjis::FromUtf8(msg) : std::move(msg);
 
         ++it;
         while (it != end && !dynamic_cast<CStringItem*>(&*it)) ++it;
@@ -113,6 +163,42 @@ namespace Neptools::Stsc
       return nullptr;
   }};
 
+  TEST_SUITE_BEGIN("Neptools::Stsc::File");
+
+  TEST_CASE("txt round trip")
+  {
+    // 0x95 0x5c is a kanji ending in '\\', followed by an 'n'
+    const std::string strs[] = { "foo", "\x95\x5cn\\nbar", "" };
+    for (bool utf8 : {false, true})
+    {
+      CAPTURE(utf8);
+      auto file = Libshit::MakeSmart<File>(Flavor::NOIRE);
+      for (const auto& s : strs)
+        file->GetChildren().push_back(*file->Create<CStringItem>(s));
+
+      std::stringstream ss;
+      txt_utf8 = utf8;
+      file->WriteTxt(ss);
+      CHECK(ss.str().find(utf8 ? "\xe8\xa1\xa8n\r\nbar\r\n" :
+                          "\x95\x5cn\r\nbar\r\n") != std::string::npos);
+
+      for (auto& it : file->GetChildren())
+        static_cast<CStringItem&>(it).string = "x";
+      file->ReadTxt(ss);
+      txt_utf8 = false;
+
+      size_t i = 0;
+      for (auto& it : file->GetChildren())
+      {
+        CAPTURE(i);
+        REQUIRE(i < std::size(strs));
+        CHECK(static_cast<CStringItem&>(it).string == strs[i++]);
+      }
+      CHECK(i == std::size(strs));
+    }
+  }
+
+  TEST_SUITE_END();
 }
 
 #include "file.binding.hpp"
@@ -3,6 +3,7 @@
 #include "../context.hpp"
 #include "../raw_item.hpp"
 #include "../../sink.hpp"
+#include "../../trace.hpp"
 
 #include <libshit/char_utils.hpp>
 
@@ -60,6 +61,7 @@ namespace Neptools::Stsc
 
   HeaderItem& HeaderItem::CreateAndInsert(ItemPointer ptr, Flavor flavor)
   {
+    Trace::Scope tr{"Stsc::HeaderItem::CreateAndInsert"};
     auto x = RawItem::GetSource(ptr, -1);
     auto& ret = x.ritem.SplitCreate<HeaderItem>(ptr.offset, x.src);
 
@@ -48,7 +48,7 @@ namespace Libshit::Lua
       &::Libshit::Lua::TypeTraits<::Neptools::Stsc::InstructionRndJumpItem>::Make<LuaGetRef<::Neptools::Item::Key>, LuaGetRef<::Neptools::Context &>, LuaGetRef<::uint8_t>, LuaGetRef<::Neptools::Source>>
     >("new");
     bld.AddFunction<
-      &::Libshit::Lua::GetSmartOwnedMember<::Neptools::Stsc::InstructionRndJumpItem, std::vector<::Libshit::NotNull<::Neptools::LabelPtr> >, &::Neptools::Stsc::InstructionRndJumpItem::tgts>
+      &::Neptools::GetXrefMember<::Neptools::Stsc::InstructionRndJumpItem, std::vector<::Libshit::NotNull<::Neptools::LabelPtr> >, &::Neptools::Stsc::InstructionRndJumpItem::tgts>
     >("get_tgts");
 
   }
@@ -82,7 +82,7 @@ namespace Libshit::Lua
       &::Libshit::Lua::GetMember<::Neptools::Stsc::InstructionJumpIfItem, ::Libshit::NotNull<::Neptools::LabelPtr>, &::Neptools::Stsc::InstructionJumpIfItem::tgt>
     >("get_tgt");
     bld.AddFunction<
-      &::Libshit::Lua::SetMember<::Neptools::Stsc::InstructionJumpIfItem, ::Libshit::NotNull<::Neptools::LabelPtr>, &::Neptools::Stsc::InstructionJumpIfItem::tgt>
+      &::Neptools::SetXrefMember<::Neptools::Stsc::InstructionJumpIfItem, ::Libshit::NotNull<::Neptools::LabelPtr>, &::Neptools::Stsc::InstructionJumpIfItem::tgt>
     >("set_tgt");
     bld.AddFunction<
       &::Libshit::Lua::GetSmartOwnedMember<::Neptools::Stsc::InstructionJumpIfItem, std::vector<::Neptools::Stsc::InstructionJumpIfItem::Node>, &::Neptools::Stsc::InstructionJumpIfItem::tree>
@@ -139,7 +139,7 @@ namespace Libshit::Lua
       &::Libshit::Lua::SetMember<::Neptools::Stsc::InstructionJumpSwitchItemNoire, bool, &::Neptools::Stsc::InstructionJumpSwitchItemNoire::last_is_default>
     >("set_last_is_default");
     bld.AddFunction<
-      &::Libshit::Lua::GetSmartOwnedMember<::Neptools::Stsc::InstructionJumpSwitchItemNoire, std::vector<::Neptools::Stsc::InstructionJumpSwitchItemNoire::Expression>, &::Neptools::Stsc::InstructionJumpSwitchItemNoire::expressions>
+      &::Neptools::GetXrefMember<::Neptools::Stsc::InstructionJumpSwitchItemNoire, std::vector<::Neptools::Stsc::InstructionJumpSwitchItemNoire::Expression>, &::Neptools::Stsc::InstructionJumpSwitchItemNoire::expressions>
     >("get_expressions");
 
   }
@@ -2,7 +2,10 @@
 
 #include "../cstring_item.hpp"
 #include "../raw_item.hpp"
+#include "../xref.hpp"
+#include "../xref.lua.hpp"
 #include "../../sink.hpp"
+#include "../../trace.hpp"
 
 #include <libshit/lua/static_class.hpp>
 #include <libshit/lua/user_type.hpp>
@@ -58,6 +61,7 @@ namespace Neptools::Stsc
   // base
   InstructionBase& InstructionBase::CreateAndInsert(ItemPointer ptr, Flavor f)
   {
+    Trace::Scope tr{"Stsc::InstructionBase::CreateAndInsert"};
     auto x = RawItem::GetSource(ptr, -1);
     x.src.CheckSize(1);
     uint8_t opcode = x.src.ReadLittleUint8();
@@ -69,6 +73,11 @@ namespace Neptools::Stsc
     return ret;
   }
 
+  void InstructionBase::CollectXrefs(XrefEntry& entry) const
+  {
+    entry.opcode = opcode;
+  }
+
   void InstructionBase::InstrDump(Sink& sink) const
   {
     sink.WriteLittleUint8(opcode);
@@ -141,6 +150,7 @@ namespace Neptools::Stsc
       static RawType Dump(T r) { return r; }
       static void Inspect(std::ostream& os, T t) { os << uint32_t(t); }
       static void PostInsert(T, Flavor) {}
+      static void Xref(T, XrefEntry&) {}
     };
 
     template<> struct Traits<float>
@@ -166,6 +176,7 @@ namespace Neptools::Stsc
 
       static void Inspect(std::ostream& os, float v) { os << v; }
       static void PostInsert(float, Flavor) {}
+      static void Xref(float, XrefEntry&) {}
     };
 
     template<> struct Traits<void*>
@@ -186,6 +197,7 @@ namespace Neptools::Stsc
       { os << PrintLabel(l); }
 
       static void PostInsert(const LabelPtr&, Flavor) {}
+      static void Xref(const LabelPtr& l, XrefEntry& e) { e.Add(l.get()); }
     };
 
     template<> struct Traits<std::string> : public Traits<void*>
@@ -211,6 +223,8 @@ namespace Neptools::Stsc
     {
       static void PostInsert(const LabelPtr& lbl, Flavor f)
       { if (lbl) MaybeCreateUnchecked<InstructionBase>(lbl->GetPtr(), f); }
+      static void Xref(const LabelPtr& l, XrefEntry& e)
+      { e.Add(l.get(), XrefKind::CODE); }
     };
 
     template <typename T, typename... Args> struct OperationsImpl;
@@ -253,6 +267,13 @@ namespace Neptools::Stsc
         FORALL(Traits<T>::PostInsert(std::get<I>(tuple), f));
       }
 
+      template <typename Tuple>
+      static void Xref(const Tuple& tuple, XrefEntry& e)
+      {
+        (void) e; // shut up, retarded gcc
+        FORALL(Traits<T>::Xref(std::get<I>(tuple), e));
+      }
+
       static constexpr size_t Size()
       {
         size_t sum = 0;
@@ -320,6 +341,14 @@ namespace Neptools::Stsc
     if (!NoReturn) MaybeCreateUnchecked<InstructionBase>(&*++Iterator(), f);
   }
 
+  template <bool NoReturn, typename... Args>
+  void SimpleInstruction<NoReturn, Args...>::CollectXrefs(
+    XrefEntry& entry) const
+  {
+    InstructionBase::CollectXrefs(entry);
+    Operations<Args...>::Xref(args, entry);
+  }
+
   // ------------------------------------------------------------------------
   // specific instruction implementations
   InstructionRndJumpItem::InstructionRndJumpItem(
@@ -374,6 +403,12 @@ namespace Neptools::Stsc
     MaybeCreateUnchecked<InstructionBase>(&*++Iterator(), f);
   }
 
+  void InstructionRndJumpItem::CollectXrefs(XrefEntry& entry) const
+  {
+    InstructionBase::CollectXrefs(entry);
+    for (const auto& l : tgts) entry.Add(&*l, XrefKind::CODE);
+  }
+
   // ------------------------------------------------------------------------
 
   void InstructionJumpIfItem::FixParams::Validate(
@@ -443,6 +478,12 @@ namespace Neptools::Stsc
     InstructionBase::Dispose();
   }
 
+  void InstructionJumpIfItem::CollectXrefs(XrefEntry& entry) const
+  {
+    InstructionBase::CollectXrefs(entry);
+    entry.Add(&*tgt, XrefKind::CODE);
+  }
+
   void InstructionJumpIfItem::Parse_(Context& ctx, Source& src)
   {
     src.CheckRemainingSize(sizeof(FixParams));
@@ -533,6 +574,12 @@ namespace Neptools::Stsc
     InstructionBase::Dispose();
   }
 
+  void InstructionJumpSwitchItemNoire::CollectXrefs(XrefEntry& entry) const
+  {
+    InstructionBase::CollectXrefs(entry);
+    for (const auto& e : expressions) entry.Add(&*e.target, XrefKind::CODE);
+  }
+
   void InstructionJumpSwitchItemNoire::Parse_(Context& ctx, Source& src)
   {
     src.CheckRemainingSize(sizeof(FixParams));
@@ -645,8 +692,11 @@ namespace Libshit::Lua
       if constexpr (I == sizeof...(Args))
         luaL_error(vm, "trying to set invalid index");
       else if (idx == I)
+      {
         std::get<I>(instr.args) = vm.Check<std::tuple_element_t<
           I, typename T::ArgsT>>(3);
+        instr.XrefChanged();
+      }
       else
         Set<I+1>(vm, instr, idx, {});
     }
@@ -24,6 +24,8 @@ namespace Neptools::Stsc
 
     const uint8_t opcode;
 
+    LIBSHIT_NOLUA void CollectXrefs(XrefEntry& entry) const override;
+
   protected:
     void InstrDump(Sink& sink) const;
     std::ostream& InstrInspect(std::ostream& os, unsigned indent) const;
@@ -95,6 +97,8 @@ namespace Neptools::Stsc
     using ArgsT = std::tuple<TupleTypeMapT<Args>...>;
     ArgsT args;
 
+    LIBSHIT_NOLUA void CollectXrefs(XrefEntry& entry) const override;
+
   private:
     void Parse_(Context& ctx, Source& src);
     void Dump_(Sink& sink) const override;
@@ -109,9 +113,11 @@ namespace Neptools::Stsc
     InstructionRndJumpItem(Key k, Context& ctx, uint8_t opcode, Source src);
     FilePosition GetSize() const noexcept override { return 2 + tgts.size()*4; }
 
-    LIBSHIT_LUAGEN(get="::Libshit::Lua::GetSmartOwnedMember")
+    LIBSHIT_LUAGEN(get="::Neptools::GetXrefMember")
     std::vector<Libshit::NotNull<LabelPtr>> tgts;
 
+    LIBSHIT_NOLUA void CollectXrefs(XrefEntry& entry) const override;
+
   private:
     void Parse_(Context& ctx, Source& src);
     void Dump_(Sink& sink) const override;
@@ -185,11 +191,13 @@ namespace Neptools::Stsc
     FilePosition GetSize() const noexcept override
     { return 1 + sizeof(FixParams) + tree.size() * sizeof(NodeParams); }
 
+    LIBSHIT_LUAGEN(set="::Neptools::SetXrefMember")
     Libshit::NotNull<LabelPtr> tgt;
     LIBSHIT_LUAGEN(get="::Libshit::Lua::GetSmartOwnedMember")
     std::vector<Node> tree;
 
     void Dispose() noexcept override;
+    LIBSHIT_NOLUA void CollectXrefs(XrefEntry& entry) const override;
 
   private:
     void Parse_(Context& ctx, Source& src);
@@ -248,10 +256,11 @@ namespace Neptools::Stsc
     uint32_t expected_val;
     bool last_is_default;
 
-    LIBSHIT_LUAGEN(get="::Libshit::Lua::GetSmartOwnedMember")
+    LIBSHIT_LUAGEN(get="::Neptools::GetXrefMember")
     std::vector<Expression> expressions;
 
     void Dispose() noexcept override;
+    LIBSHIT_NOLUA void CollectXrefs(XrefEntry& entry) const override;
 
   protected:
     InstructionJumpSwitchItemNoire(Key k, Context& ctx, uint8_t opcode)
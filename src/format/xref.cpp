@@ -0,0 +1,167 @@
+#include "xref.hpp"
+#include "item.hpp"
+#include "stcm/file.hpp"
+#include "stcm/instruction.hpp"
+
+#include <algorithm>
+
+#include <libshit/doctest.hpp>
+
+namespace Neptools
+{
+  TEST_SUITE_BEGIN("Neptools::Xref");
+
+  void XrefIndex::Add(Item& item)
+  {
+    Update(item);
+    if (auto iwc = dynamic_cast<ItemWithChildren*>(&item))
+      for (auto& c : iwc->GetChildren()) Add(c);
+  }
+
+  void XrefIndex::Update(Item& item)
+  {
+    Remove(item);
+
+    XrefEntry e;
+    item.CollectXrefs(e);
+    if (e.Empty()) return;
+
+    auto& ent = items[&item];
+    try
+    {
+      if (e.opcode) opcodes[*e.opcode].insert(&item);
+      for (const auto& [lbl, kind] : e.labels)
+        labels[lbl.get()][&item] |= static_cast<unsigned>(kind);
+      ent = std::move(e);
+    }
+    catch (...)
+    {
+      ent = std::move(e);
+      Remove(item);
+      throw;
+    }
+  }
+
+  void XrefIndex::Remove(const Item& item) noexcept
+  {
+    auto it = items.find(&item);
+    if (it == items.end()) return;
+
+    auto nitem = const_cast<Item*>(&item);
+    if (auto& oc = it->second.opcode)
+      if (auto oit = opcodes.find(*oc); oit != opcodes.end())
+      {
+        oit->second.erase(nitem);
+        if (oit->second.empty()) opcodes.erase(oit);
+      }
+
+    for (const auto& l : it->second.labels)
+      if (auto lit = labels.find(l.first.get()); lit != labels.end())
+      {
+        lit->second.erase(nitem);
+        if (lit->second.empty()) labels.erase(lit);
+      }
+
+    items.erase(it);
+  }
+
+  static std::vector<Item*> SortByPosition(std::vector<Item*> v)
+  {
+    std::sort(v.begin(), v.end(), [](Item* a, Item* b)
+              { return a->GetPosition() < b->GetPosition(); });
+    return v;
+  }
+
+  std::vector<Item*> XrefIndex::GetReferences(
+    const Label& lbl, unsigned kinds) const
+  {
+    std::vector<Item*> ret;
+    auto it = labels.find(&lbl);
+    if (it == labels.end()) return ret;
+
+    for (const auto& [item, k] : it->second)
+      if (k & kinds) ret.push_back(item);
+    return SortByPosition(std::move(ret));
+  }
+
+  std::vector<Item*> XrefIndex::GetByOpcode(uint32_t opcode) const
+  {
+    auto it = opcodes.find(opcode);
+    if (it == opcodes.end()) return {};
+    return SortByPosition({it->second.begin(), it->second.end()});
+  }
+
+  const XrefEntry* XrefIndex::GetEntry(const Item& item) const noexcept
+  {
+    auto it = items.find(&item);
+    return it == items.end() ? nullptr : &it->second;
+  }
+
+  TEST_CASE("xref index follows edits")
+  {
+    using Stcm::InstructionItem;
+    using Param = InstructionItem::Param;
+    using V = std::vector<Item*>;
+    auto ptrs = [](const Context::ItemVector& v)
+    {
+      V ret;
+      for (const auto& i : v) ret.push_back(i.get());
+      return ret;
+    };
+
+    auto file = Libshit::MakeSmart<Stcm::File>();
+    auto& ch = file->GetChildren();
+    auto a = file->Create<InstructionItem>(uint32_t(1));
+    auto b = file->Create<InstructionItem>(uint32_t(2));
+    ch.push_back(*a);
+    ch.push_back(*b);
+    auto lbl = file->CreateLabelFallback("tgt", ItemPointer{b.get()});
+    auto c = file->Create<InstructionItem>(lbl);
+    ch.push_back(*c);
+    file->Fixup();
+
+    // built on first query
+    CHECK(ptrs(file->GetInstructionsByOpcode(1)) == V{a.get()});
+    CHECK(ptrs(file->GetCallers(*lbl)) == V{c.get()});
+    CHECK(ptrs(file->GetReferences(*lbl)) == V{c.get()});
+
+    // insert
+    auto d = file->Create<InstructionItem>(uint32_t(1));
+    d->params.push_back(Param::New<Param::Type::INSTR_PTR0>(lbl));
+    ch.insert(b->Iterator(), *d);
+    file->Fixup();
+    CHECK(ptrs(file->GetInstructionsByOpcode(1)) == V{a.get(), d.get()});
+    CHECK(ptrs(file->GetCallers(*lbl)) == V{d.get(), c.get()});
+
+    // setters
+    c->SetOpcode(1);
+    CHECK(ptrs(file->GetCallers(*lbl)) == V{d.get()});
+    CHECK(ptrs(file->GetInstructionsByOpcode(1)) ==
+          V{a.get(), d.get(), c.get()});
+    a->SetTarget(lbl);
+    CHECK(ptrs(file->GetCallers(*lbl)) == V{a.get(), d.get()});
+    CHECK(file->GetInstructionsByOpcode(2).size() == 1);
+    REQUIRE(file->GetCallees(*a).size() == 1);
+    CHECK(file->GetCallees(*a)[0].get() == lbl.get());
+    CHECK(file->GetCallees(*c).empty());
+
+    // param edits: with notification...
+    d->params.clear();
+    d->XrefChanged();
+    CHECK(ptrs(file->GetCallers(*lbl)) == V{a.get()});
+    // ...or without it on volatile items (like after lua got the params)
+    b->MarkXrefVolatile();
+    b->params.push_back(Param::New<Param::Type::INSTR_PTR1>(lbl));
+    CHECK(ptrs(file->GetCallers(*lbl)) == V{a.get(), b.get()});
+
+    // remove
+    ch.erase(a->Iterator());
+    CHECK(ptrs(file->GetCallers(*lbl)) == V{b.get()});
+    CHECK(ptrs(file->GetInstructionsByOpcode(1)) == V{d.get(), c.get()});
+    ch.erase(b->Iterator());
+    b->params.clear(); // no longer volatile, not in the index
+    CHECK(file->GetCallers(*lbl).empty());
+  }
+
+  TEST_SUITE_END();
+}
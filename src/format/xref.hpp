@@ -0,0 +1,63 @@
+#ifndef UUID_2962AD9F_494A_4F02_8A59_DC79A1D2BC18
+#define UUID_2962AD9F_494A_4F02_8A59_DC79A1D2BC18
+#pragma once
+
+#include "item_base.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace Neptools
+{
+
+  class Item;
+
+  enum class XrefKind : unsigned
+  {
+    DATA = 1, // item reads/points to the label
+    CODE = 2, // control transfer: call or jump
+  };
+
+  // Everything an item refers to. Filled by Item::CollectXrefs. Labels are
+  // kept alive by the entry, so the index never has dangling keys even if the
+  // item changed without notifying the context.
+  struct XrefEntry
+  {
+    std::optional<uint32_t> opcode;
+    std::vector<std::pair<LabelPtr, XrefKind>> labels;
+
+    void Add(Label* lbl, XrefKind kind = XrefKind::DATA)
+    { if (lbl) labels.emplace_back(lbl, kind); }
+    bool Empty() const noexcept { return !opcode && labels.empty(); }
+  };
+
+  // label -> referring items and opcode -> instructions index of a context.
+  // Context creates it on the first query and keeps it up to date afterwards
+  // (see Context::UpdateXref).
+  class XrefIndex
+  {
+  public:
+    // Add adds item and all of its children, Remove only removes item (Item's
+    // Removed is already called recursively).
+    void Add(Item& item);
+    // re-collect only item (not its children)
+    void Update(Item& item);
+    void Remove(const Item& item) noexcept;
+
+    std::vector<Item*> GetReferences(const Label& lbl, unsigned kinds) const;
+    std::vector<Item*> GetByOpcode(uint32_t opcode) const;
+    const XrefEntry* GetEntry(const Item& item) const noexcept;
+
+  private:
+    std::unordered_map<const Item*, XrefEntry> items;
+    std::unordered_map<const Label*, std::unordered_map<Item*, unsigned>> labels;
+    std::unordered_map<uint32_t, std::unordered_set<Item*>> opcodes;
+  };
+
+}
+
+#endif
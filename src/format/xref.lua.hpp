@@ -0,0 +1,35 @@
+#ifndef UUID_E7B3C915_0A4D_4E8F_9C26_5D1F83A7B0E4
+#define UUID_E7B3C915_0A4D_4E8F_9C26_5D1F83A7B0E4
+#pragma once
+
+#if LIBSHIT_WITH_LUA
+
+#include "item.hpp"
+
+#include <libshit/lua/user_type.hpp>
+
+namespace Neptools
+{
+
+  // Lua accessors of item members holding references (see
+  // Item::CollectXrefs), for LIBSHIT_LUAGEN(get=...)/(set=...). Containers can
+  // be modified through the returned object without the item knowing, so the
+  // item is marked volatile; setters update the index directly.
+  template <typename Class, typename T, T Class::*Member>
+  decltype(auto) GetXrefMember(Class& cls)
+  {
+    cls.MarkXrefVolatile();
+    return Libshit::Lua::GetSmartOwnedMember<Class, T, Member>(cls);
+  }
+
+  template <typename Class, typename T, T Class::*Member>
+  void SetXrefMember(Class& cls, const T& val)
+  {
+    cls.*Member = val;
+    cls.XrefChanged();
+  }
+
+}
+
+#endif
+#endif
@@ -2,6 +2,8 @@
 
 #include <libshit/except.hpp>
 
+#include <algorithm>
+
 #if LIBSHIT_OS_IS_WINDOWS
 #  define NOMINMAX
 #  define WIN32_LEAN_AND_MEAN
@@ -14,6 +16,7 @@
 #  include <unistd.h>
 #  if !LIBSHIT_OS_IS_VITA
 #    include <sys/mman.h>
+#    include <sys/uio.h>
 #  endif
 #endif
 
@@ -105,6 +108,8 @@ namespace Neptools
       SYSERROR("ReadFile");
   }
 
+  void LowIo::Prefetch(FilePosition, FilePosition) const noexcept {}
+
   void LowIo::Pwrite(const void* buf, FileMemSize len, FilePosition offs) const
   {
     DWORD size;
@@ -124,6 +129,12 @@ namespace Neptools
       SYSERROR("WriteFile");
   }
 
+  void LowIo::Writev(const WriteVec* bufs, std::size_t count) const
+  {
+    for (std::size_t i = 0; i < count; ++i)
+      Write(bufs[i].first, bufs[i].second);
+  }
+
 #else // linux/unix
 
 #  define SYSERROR(x)                                           \
@@ -194,6 +205,14 @@ namespace Neptools
     if (pread(fd, buf, len, offs) != len) SYSERROR("pread");
   }
 
+  void LowIo::Prefetch(FilePosition offs, FilePosition len) const noexcept
+  {
+#if defined(POSIX_FADV_WILLNEED) && !LIBSHIT_OS_IS_VITA
+    // only a hint, errors don't matter
+    if (fd != -1) posix_fadvise(fd, offs, len, POSIX_FADV_WILLNEED);
+#endif
+  }
+
   void LowIo::Pwrite(const void* buf, FileMemSize len, FilePosition offs) const
   {
     if (pwrite(fd, buf, len, offs) != len) SYSERROR("pwrite");
@@ -204,5 +223,29 @@ namespace Neptools
     if (write(fd, buf, len) != len) SYSERROR("write");
   }
 
+  void LowIo::Writev(const WriteVec* bufs, std::size_t count) const
+  {
+#if LIBSHIT_OS_IS_VITA
+    for (std::size_t i = 0; i < count; ++i)
+      Write(bufs[i].first, bufs[i].second);
+#else
+    while (count)
+    {
+      struct iovec vec[16]; // POSIX guarantees IOV_MAX >= 16
+      std::size_t n = std::min<std::size_t>(count, 16);
+      ssize_t len = 0;
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        vec[i].iov_base = const_cast<void*>(bufs[i].first);
+        vec[i].iov_len = bufs[i].second;
+        len += bufs[i].second;
+      }
+      if (writev(fd, vec, n) != len) SYSERROR("writev");
+      bufs += n;
+      count -= n;
+    }
+#endif
+  }
+
 #endif
 }
@@ -6,6 +6,8 @@
 
 #include <libshit/platform.hpp>
 
+#include <utility>
+
 namespace Neptools
 {
 
@@ -21,6 +23,8 @@ namespace Neptools
     static constexpr const size_t MEM_CHUNK  = 8*1024; // 8KiB
     static constexpr const size_t MMAP_CHUNK = 128*1024; // 128KiB
     static constexpr const size_t MMAP_LIMIT = 1*1024*1024; // 1MiB
+    // mmap offsets must be aligned to this (allocation granularity on windows)
+    static constexpr const size_t MMAP_ALIGN = 64*1024; // 64KiB
 
 
     LowIo() noexcept = default;
@@ -57,8 +61,13 @@ namespace Neptools
     void* Mmap(FilePosition offs, FileMemSize size, bool write) const;
     static void Munmap(void* ptr, FileMemSize len);
     void Pread(void* buf, FileMemSize len, FilePosition offs) const;
+    // hint that [offs, offs+len) will be read soon (asynchronous readahead)
+    void Prefetch(FilePosition offs, FilePosition len) const noexcept;
     void Pwrite(const void* buf, FileMemSize len, FilePosition offs) const;
     void Write(const void* buf, FileMemSize len) const;
+    // gathering Write
+    using WriteVec = std::pair<const void*, FileMemSize>;
+    void Writev(const WriteVec* bufs, std::size_t count) const;
 
     FdType fd = INVALID_FD;
 #if LIBSHIT_OS_IS_WINDOWS
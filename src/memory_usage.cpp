@@ -0,0 +1,94 @@
+#include "memory_usage.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+#include <libshit/doctest.hpp>
+
+namespace Neptools
+{
+  TEST_SUITE_BEGIN("Neptools::MemoryUsage");
+
+  void MemoryUsage::Add(
+    const std::string& category, std::size_t bytes, std::size_t count)
+  {
+    auto& e = entries[category];
+    e.count += count;
+    e.bytes += bytes;
+    total += bytes;
+  }
+
+  void MemoryUsage::AddObject(const std::type_info& type, std::size_t fallback)
+  {
+    auto size = Stats::GetItemSize(type);
+    Add(GetName(type), size ? size : fallback);
+  }
+
+  void MemoryUsage::AddExtra(const std::type_info& type, std::size_t bytes)
+  {
+    if (bytes) Add(GetName(type), bytes, 0);
+  }
+
+  void MemoryUsage::AddString(const std::string& str)
+  {
+    static const auto inline_cap = std::string{}.capacity();
+    if (str.capacity() > inline_cap) Add("strings", str.capacity() + 1);
+  }
+
+  const std::string& MemoryUsage::GetName(const std::type_info& type)
+  {
+    auto it = names.find(type);
+    if (it == names.end())
+      it = names.emplace(type, Stats::GetTypeName(type)).first;
+    return it->second;
+  }
+
+  void MemoryUsage::Print(std::ostream& os) const
+  {
+    std::vector<const Map::value_type*> sorted;
+    sorted.reserve(entries.size());
+    for (const auto& e : entries) sorted.push_back(&e);
+    std::sort(sorted.begin(), sorted.end(), [](auto a, auto b)
+              { return a->second.bytes > b->second.bytes; });
+
+    os << std::setw(40) << std::left << "  Total" << std::right
+       << std::setw(12) << total << " bytes\n";
+    for (const auto* e : sorted)
+    {
+      os << "  " << std::setw(38) << std::left << e->first << std::right
+         << std::setw(12) << e->second.bytes << " bytes";
+      if (e->second.count) os << " in " << e->second.count;
+      os << '\n';
+    }
+  }
+
+  TEST_CASE("memory usage")
+  {
+    struct Foo { char x[17]; };
+    MemoryUsage mu;
+    mu.AddObject(typeid(Foo), 100);
+    mu.AddExtra(typeid(Foo), 20);
+    mu.AddExtra(typeid(Foo), 0);
+    mu.AddString("short");
+    mu.AddString(std::string(100, 'x'));
+
+    auto& ents = mu.GetEntries();
+    REQUIRE(ents.size() == 2);
+    auto& foo = std::find_if(ents.begin(), ents.end(), [](const auto& e)
+                             { return e.first != "strings"; })->second;
+    CHECK(foo.count == 1);
+    CHECK(foo.bytes == 120);
+    CHECK(ents.at("strings").count == 1);
+    CHECK(ents.at("strings").bytes > 100);
+    CHECK(mu.GetTotal() == 120 + ents.at("strings").bytes);
+
+    int x;
+    CHECK(mu.FirstSeen(&x));
+    CHECK(!mu.FirstSeen(&x));
+  }
+
+  TEST_SUITE_END();
+}
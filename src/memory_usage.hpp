@@ -0,0 +1,58 @@
+#ifndef UUID_3C7A9E12_64B8_4D0F_8B25_F1E07A5D9C43
+#define UUID_3C7A9E12_64B8_4D0F_8B25_F1E07A5D9C43
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Neptools
+{
+
+  // Estimated memory held by parsed files, broken down by category (item
+  // types, labels, strings, gbnl rows, source buffers...). Sizes are what the
+  // objects and their containers allocate, without allocator overhead. Filled
+  // by Dumpable::GetMemoryUsage, objects shared between several files (like
+  // the provider of sources opened from the same file) are only counted once
+  // per MemoryUsage.
+  class MemoryUsage
+  {
+  public:
+    struct Entry { std::size_t count = 0, bytes = 0; };
+    using Map = std::map<std::string, Entry>;
+
+    void Add(const std::string& category, std::size_t bytes,
+             std::size_t count = 1);
+    // one object of the given dynamic type: its size if it was created with
+    // Context::Create, fallback otherwise
+    void AddObject(const std::type_info& type, std::size_t fallback);
+    // memory owned by an object, not counted as a separate object
+    void AddExtra(const std::type_info& type, std::size_t bytes);
+    // heap buffer of the string (nothing if it's stored inline)
+    void AddString(const std::string& str);
+
+    // true the first time it's called with ptr
+    bool FirstSeen(const void* ptr) { return seen.insert(ptr).second; }
+
+    const Map& GetEntries() const noexcept { return entries; }
+    std::size_t GetTotal() const noexcept { return total; }
+
+    void Print(std::ostream& os) const;
+
+  private:
+    const std::string& GetName(const std::type_info& type);
+
+    Map entries;
+    std::size_t total = 0;
+    std::unordered_set<const void*> seen;
+    std::unordered_map<std::type_index, std::string> names;
+  };
+
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "open.hpp"
+#include "trace.hpp"
 
 #include <libshit/except.hpp>
 
@@ -7,6 +8,8 @@ namespace Neptools
 
   auto OpenFactory::Open(Source src) -> Libshit::NotNull<Ret>
   {
+    Trace::Scope tr{"OpenFactory::Open", src.GetFileName()};
+    Stats::PhaseTimer t{Stats::Phase::PARSE};
     for (auto& x : GetStore())
     {
       auto ret = x(src);
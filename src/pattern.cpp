@@ -1,17 +1,61 @@
 #include "pattern.hpp"
 
 #include <libshit/assert.hpp>
+#include <libshit/doctest.hpp>
 
-#include <boost/algorithm/searching/boyer_moore.hpp>
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <random>
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+  (defined(__i386__) || defined(__x86_64__))
+#  define NEPTOOLS_PATTERN_SIMD 1
+#  define NEPTOOLS_TARGET(x) __attribute__((target(x)))
+#  include <cpuid.h>
+#  include <immintrin.h>
+#else
+#  define NEPTOOLS_PATTERN_SIMD 0
+#endif
 
 #define LIBSHIT_LOG_NAME "pattern"
 #include <libshit/logger_helper.hpp>
 
 namespace Neptools
 {
+  TEST_SUITE_BEGIN("Neptools::Pattern");
+
+  namespace { enum class Kernel { SCALAR, SSE2, AVX2 }; }
+
+#if NEPTOOLS_PATTERN_SIMD
+  static Kernel DetectKernel() noexcept
+  {
+    unsigned a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d) || !(d & bit_SSE2))
+      return Kernel::SCALAR;
+
+    // AVX2 also needs the OS to save the ymm registers
+    if ((c & bit_OSXSAVE) && (c & bit_AVX) && __get_cpuid_max(0, nullptr) >= 7)
+    {
+      unsigned lo, hi;
+      __asm__("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+      __cpuid_count(7, 0, a, b, c, d);
+      if ((lo & 6) == 6 && (b & bit_AVX2)) return Kernel::AVX2;
+    }
+    return Kernel::SSE2;
+  }
+#else
+  static Kernel DetectKernel() noexcept { return Kernel::SCALAR; }
+#endif
+
+  static Kernel GetKernel() noexcept
+  {
+    static const Kernel kernel = DetectKernel();
+    return kernel;
+  }
 
   static bool CheckPattern(
-    const Byte* ptr, const Byte* pattern, const Byte* mask, size_t len)
+    const Byte* ptr, const Byte* pattern, const Byte* mask, size_t len) noexcept
   {
     while (len--)
       if ((*ptr++ & *mask++) != *pattern++)
@@ -19,59 +63,337 @@ namespace Neptools
     return true;
   }
 
-  const Byte* Pattern::MaybeFind(Libshit::StringView data) const noexcept
+#if NEPTOOLS_PATTERN_SIMD
+  NEPTOOLS_TARGET("sse2")
+  static bool CheckPatternSse2(
+    const Byte* ptr, const Byte* pattern, const Byte* mask, size_t len) noexcept
+  {
+    for (; len >= 16; ptr += 16, pattern += 16, mask += 16, len -= 16)
+    {
+      auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+      auto m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask));
+      auto p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern));
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(d, m), p)) != 0xffff)
+        return false;
+    }
+    return CheckPattern(ptr, pattern, mask, len);
+  }
+
+  NEPTOOLS_TARGET("avx2")
+  static bool CheckPatternAvx2(
+    const Byte* ptr, const Byte* pattern, const Byte* mask, size_t len) noexcept
+  {
+    for (; len >= 32; ptr += 32, pattern += 32, mask += 32, len -= 32)
+    {
+      auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+      auto m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask));
+      auto p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pattern));
+      if (_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_and_si256(d, m), p)) != -1)
+        return false;
+    }
+    return CheckPatternSse2(ptr, pattern, mask, len);
+  }
+#endif
+
+  using CheckFun = bool (*)(
+    const Byte*, const Byte*, const Byte*, size_t) noexcept;
+  static CheckFun GetCheck(Kernel kernel) noexcept
   {
-    size_t max_len = 0, max_i = 0;
-    size_t start_i = 0;
-    for (size_t i = 0; i < size; ++i)
-      if (mask[i] == 0xff)
+    switch (kernel)
+    {
+#if NEPTOOLS_PATTERN_SIMD
+    case Kernel::AVX2: return CheckPatternAvx2;
+    case Kernel::SSE2: return CheckPatternSse2;
+#endif
+    default: return CheckPattern;
+    }
+  }
+
+  namespace
+  {
+    struct Matches
+    {
+      const Byte* res = nullptr;
+
+      // false on the second match
+      bool Add(const Byte* match) noexcept
       {
-        if (i - start_i + 1 > max_len)
+        if (res)
         {
-          max_len = i - start_i + 1;
-          max_i = start_i;
+          // todo?
+          WARN << "Multiple matches for pattern "
+            << static_cast<const void*>(res) << " and "
+            << static_cast<const void*>(match) << std::endl;
+          res = nullptr;
+          return false;
         }
+        res = match;
+        return true;
       }
-      else
-        start_i = i+1;
+    };
+  }
 
-    LIBSHIT_ASSERT(max_i + max_len <= size);
-    boost::algorithm::boyer_moore<const Byte*> bm{
-      pattern + max_i, pattern + max_i + max_len};
+#if NEPTOOLS_PATTERN_SIMD
+  // Horspool only wins when it can skip more than a vector per step, below
+  // this anchor size test 16/32 positions at once with the SIMD probes.
+  static constexpr const size_t SIMD_MAX_ANCHOR = 32;
 
-    auto ptr = data.udata() + max_i;
-    auto ptr_end = data.udata() + data.length() - (size - max_len - max_i);
-    const Byte* res = nullptr;
+#define NEPTOOLS_GEN_SIMD_FIND(name, target, width, vec, pref, bits, check) \
+  NEPTOOLS_TARGET(target)                                                   \
+  static const Byte* name(const Pattern& pat, const PatternSearch& search,  \
+                          Libshit::StringView data) noexcept                \
+  {                                                                         \
+    auto ptr = data.udata();                                                \
+    auto len = data.length();                                               \
+    if (len < pat.size) return nullptr;                                     \
+                                                                            \
+    auto a = search.probe_a, b = search.probe_b;                            \
+    auto ma = pref##_set1_epi8(static_cast<char>(pat.mask[a]));             \
+    auto pa = pref##_set1_epi8(static_cast<char>(pat.pattern[a]));          \
+    auto mb = pref##_set1_epi8(static_cast<char>(pat.mask[b]));             \
+    auto pb = pref##_set1_epi8(static_cast<char>(pat.pattern[b]));          \
+    auto last = len - pat.size, max_probe = std::max(a, b);                 \
+                                                                            \
+    Matches m;                                                              \
+    size_t i = 0;                                                           \
+    for (; i + width + max_probe <= len; i += width)                        \
+    {                                                                       \
+      auto da = pref##_loadu_si##bits(                                      \
+        reinterpret_cast<const vec*>(ptr + i + a));                         \
+      auto db = pref##_loadu_si##bits(                                      \
+        reinterpret_cast<const vec*>(ptr + i + b));                         \
+      auto found = static_cast<std::uint32_t>(pref##_movemask_epi8(         \
+        pref##_and_si##bits(                                                \
+          pref##_cmpeq_epi8(pref##_and_si##bits(da, ma), pa),               \
+          pref##_cmpeq_epi8(pref##_and_si##bits(db, mb), pb))));            \
+      for (; found; found &= found - 1)                                     \
+      {                                                                     \
+        auto pos = i + __builtin_ctz(found);                                \
+        if (pos <= last &&                                                  \
+            check(ptr + pos, pat.pattern, pat.mask, pat.size) &&            \
+            !m.Add(ptr + pos))                                              \
+          return nullptr;                                                   \
+      }                                                                     \
+    }                                                                       \
+                                                                            \
+    for (; i <= last; ++i)                                                  \
+      if (check(ptr + i, pat.pattern, pat.mask, pat.size) &&                \
+          !m.Add(ptr + i))                                                  \
+        return nullptr;                                                     \
+    return m.res;                                                           \
+  }
+
+  NEPTOOLS_GEN_SIMD_FIND(
+    SimdFindSse2, "sse2", 16, __m128i, _mm, 128, CheckPatternSse2)
+  NEPTOOLS_GEN_SIMD_FIND(
+    SimdFindAvx2, "avx2", 32, __m256i, _mm256, 256, CheckPatternAvx2)
+#undef NEPTOOLS_GEN_SIMD_FIND
+#endif
+  static const Byte* MaybeFindKernel(
+    const Pattern& pat, Libshit::StringView data, Kernel kernel) noexcept
+  {
+    PatternSearch tmp_search;
+    if (!pat.search)
+      tmp_search = MakePatternSearch(pat.pattern, pat.mask, pat.size);
+    const auto& search = pat.search ? *pat.search : tmp_search;
 
-    while (true)
+    auto len = data.length(), size = pat.size;
+    if (len < size) return nullptr;
+#if NEPTOOLS_PATTERN_SIMD
+    if (search.anchor_size < SIMD_MAX_ANCHOR && size &&
+        kernel != Kernel::SCALAR)
     {
-      DBG(4) << "finding " << static_cast<const void*>(ptr) << "..."
-        <<  static_cast<const void*>(ptr_end) << std::endl;
-      auto match = bm(ptr, ptr_end)
-#if BOOST_VERSION >= 106200
-        // I hope you die a horrible death
-        // https://github.com/boostorg/algorithm/commit/205f5ff4bbb00ece289892089a6c94c975e97ca2
-        .first
+      auto res = kernel == Kernel::AVX2 ?
+        SimdFindAvx2(pat, search, data) : SimdFindSse2(pat, search, data);
+      DBG(3) << "Found pattern @" << static_cast<const void*>(res) << std::endl;
+      return res;
+    }
 #endif
-        ;
-      DBG(4) << "match @" << static_cast<const void*>(match) << std::endl;
-      if (match == ptr_end) break;
 
-      if (CheckPattern(match - max_i, pattern, mask, size))
-        if (res)
+    // horspool on the anchor, then verify the whole pattern
+    auto check = GetCheck(kernel);
+    auto offs = search.anchor_offset, last = search.anchor_size - 1;
+    auto ptr = data.udata();
+    Matches m;
+    for (size_t i = 0; i <= len - size;
+         i += search.anchor_size ? search.skip[ptr[i + offs + last]] : 1)
+    {
+      if (search.anchor_size &&
+          ptr[i + offs + last] != pat.pattern[offs + last])
+        continue;
+      if (check(ptr + i, pat.pattern, pat.mask, size) && !m.Add(ptr + i))
+        return nullptr;
+    }
+    DBG(3) << "Found pattern @" << static_cast<const void*>(m.res) << std::endl;
+    return m.res;
+  }
+
+  const Byte* Pattern::MaybeFind(Libshit::StringView data) const noexcept
+  { return MaybeFindKernel(*this, data, GetKernel()); }
+
+  static constexpr const auto NO_STATE =
+    std::numeric_limits<std::uint32_t>::max();
+
+  PatternSet::PatternSet(std::initializer_list<Pattern> patterns)
+  {
+    items.reserve(patterns.size());
+    next.resize(256, NO_STATE);
+    out.resize(1);
+
+    // build a trie of the anchors
+    for (const auto& p : patterns)
+    {
+      auto search = p.search ? *p.search :
+        MakePatternSearch(p.pattern, p.mask, p.size);
+      auto offs = search.anchor_offset, len = search.anchor_size;
+      auto idx = items.size();
+      items.push_back({p, offs, len});
+      if (len == 0)
+      {
+        unanchored.push_back(idx);
+        continue;
+      }
+
+      std::uint32_t state = 0;
+      for (size_t i = offs; i < offs + len; ++i)
+      {
+        auto& n = next[state * 256 + p.pattern[i]];
+        if (n == NO_STATE)
         {
-          // todo?
-          WARN << "Multiple matches for pattern "
-            << static_cast<const void*>(res) << " and "
-            << static_cast<const void*>(match - max_i) << std::endl;
-          return nullptr;
+          n = out.size();
+          out.emplace_back();
+          next.resize(next.size() + 256, NO_STATE);
         }
+        state = next[state * 256 + p.pattern[i]];
+      }
+      out[state].push_back(idx);
+    }
+
+    // turn it into a DFA: missing transitions follow the failure links
+    std::vector<std::uint32_t> fail(out.size());
+    std::deque<std::uint32_t> queue;
+    for (size_t c = 0; c < 256; ++c)
+      if (next[c] == NO_STATE) next[c] = 0;
+      else
+      {
+        fail[next[c]] = 0;
+        queue.push_back(next[c]);
+      }
+
+    while (!queue.empty())
+    {
+      auto state = queue.front();
+      queue.pop_front();
+      const auto& fout = out[fail[state]];
+      out[state].insert(out[state].end(), fout.begin(), fout.end());
+
+      for (size_t c = 0; c < 256; ++c)
+      {
+        auto& n = next[state * 256 + c];
+        auto fn = next[fail[state] * 256 + c];
+        if (n == NO_STATE) n = fn;
         else
-          res = match - max_i;
-      ptr = match + 1;
+        {
+          fail[n] = fn;
+          queue.push_back(n);
+        }
+      }
     }
-    DBG(3) << "Found pattern @" << static_cast<const void*>(res) << std::endl;
+  }
+
+  std::vector<const Byte*> PatternSet::MaybeFind(
+    Libshit::StringView data) const
+  {
+    std::vector<const Byte*> res(items.size());
+    std::vector<bool> multiple(items.size());
+    auto begin = data.udata();
+    auto len = data.length();
+
+    auto check_pattern = GetCheck(GetKernel());
+    auto check = [&](size_t idx, size_t start)
+    {
+      const auto& p = items[idx].pattern;
+      if (multiple[idx] || start + p.size > len ||
+          !check_pattern(begin + start, p.pattern, p.mask, p.size))
+        return;
+
+      if (res[idx])
+      {
+        WARN << "Multiple matches for pattern #" << idx << ' '
+             << static_cast<const void*>(res[idx]) << " and "
+             << static_cast<const void*>(begin + start) << std::endl;
+        multiple[idx] = true;
+        res[idx] = nullptr;
+      }
+      else
+        res[idx] = begin + start;
+    };
+
+    std::uint32_t state = 0;
+    for (size_t i = 0; i < len; ++i)
+    {
+      for (auto idx : unanchored) check(idx, i);
+
+      state = next[state * 256 + begin[i]];
+      for (auto idx : out[state])
+      {
+        // i is the last byte of the anchor
+        auto back = items[idx].anchor_offset + items[idx].anchor_size - 1;
+        if (i >= back) check(idx, i - back);
+      }
+    }
+
+    for (size_t i = 0; i < res.size(); ++i)
+      DBG(3) << "Found pattern #" << i << " @"
+             << static_cast<const void*>(res[i]) << std::endl;
     return res;
   }
 
+  std::vector<const Byte*> PatternSet::Find(Libshit::StringView data) const
+  {
+    auto ret = MaybeFind(data);
+    for (size_t i = 0; i < ret.size(); ++i)
+      if (!ret[i])
+        LIBSHIT_THROW(std::runtime_error, "Couldn't find pattern",
+                      "Pattern index", i);
+    return ret;
+  }
+
+  TEST_CASE("simd kernels")
+  {
+    std::mt19937 rnd{42};
+    std::vector<Byte> data(4096 + 7);
+    for (auto& b : data) b = rnd();
+    Libshit::StringView sv{data.data(), data.size()};
+
+    Byte pattern[40], mask[40];
+    for (int n = 0; n < 100; ++n)
+    {
+      size_t size = 4 + rnd() % 36;
+      size_t pos = rnd() % (data.size() - size + 1);
+      for (size_t i = 0; i < size; ++i)
+      {
+        auto r = rnd() % 4;
+        mask[i] = r == 0 ? 0 : r == 1 ? Byte(rnd()) : 0xff;
+        pattern[i] = data[pos+i] & mask[i];
+      }
+      Pattern p{pattern, mask, size};
+
+      auto exp = MaybeFindKernel(p, sv, Kernel::SCALAR);
+      CHECK((exp == nullptr || exp == data.data() + pos));
+      for (auto k : {Kernel::SSE2, Kernel::AVX2})
+        if (k <= GetKernel())
+        {
+          CAPTURE(static_cast<int>(k));
+          CHECK(MaybeFindKernel(p, sv, k) == exp);
+          CHECK(GetCheck(k)(data.data() + pos, pattern, mask, size));
+          auto other = data.data() + (pos + size < data.size() ? pos+1 : pos-1);
+          CHECK(GetCheck(k)(other, pattern, mask, size) ==
+                CheckPattern(other, pattern, mask, size));
+        }
+    }
+  }
+
+  TEST_SUITE_END();
 }
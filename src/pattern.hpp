@@ -6,14 +6,84 @@
 #include <libshit/except.hpp>
 #include <libshit/nonowning_string.hpp>
 
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
 namespace Neptools
 {
 
+  // Everything the search needs that only depends on the pattern. Patterns
+  // from NEPTOOLS_PATTERN have it generated at compile time, for the others
+  // it's computed on each search.
+  struct PatternSearch
+  {
+    // longest run of fully masked (0xff) bytes
+    size_t anchor_offset = 0, anchor_size = 0;
+    // the two bytes with the most mask bits set, as far from each other as
+    // possible, for the SIMD search
+    size_t probe_a = 0, probe_b = 0;
+    // horspool shift for each byte value at the end of the anchor
+    std::uint8_t skip[256] = {};
+  };
+
+  constexpr PatternSearch MakePatternSearch(
+    const Byte* pattern, const Byte* mask, size_t size) noexcept
+  {
+    PatternSearch ret;
+
+    size_t start = 0;
+    for (size_t i = 0; i < size; ++i)
+      if (mask[i] == 0xff)
+      {
+        if (i - start + 1 > ret.anchor_size)
+        {
+          ret.anchor_size = i - start + 1;
+          ret.anchor_offset = start;
+        }
+      }
+      else
+        start = i+1;
+
+    auto bits = [&](size_t i)
+    {
+      unsigned n = 0;
+      for (unsigned m = mask[i]; m; m &= m-1) ++n;
+      return n;
+    };
+    auto& a = ret.probe_a;
+    for (size_t i = 1; i < size; ++i)
+      if (bits(i) > bits(a)) a = i;
+    auto& b = ret.probe_b;
+    size_t b_dist = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+      if (i == a || bits(i) == 0) continue;
+      size_t dist = i > a ? i - a : a - i;
+      if (b == a || bits(i) > bits(b) || (bits(i) == bits(b) && dist > b_dist))
+      {
+        b = i;
+        b_dist = dist;
+      }
+    }
+
+    // shifts are clamped, a shorter shift is still correct
+    auto max_skip = ret.anchor_size < 255 ? ret.anchor_size : 255;
+    for (auto& s : ret.skip) s = max_skip;
+    for (size_t i = 0; i + 1 < ret.anchor_size; ++i)
+    {
+      auto s = ret.anchor_size - 1 - i;
+      ret.skip[pattern[ret.anchor_offset + i]] = s < 255 ? s : 255;
+    }
+    return ret;
+  }
+
   struct Pattern
   {
     const Byte* pattern;
     const Byte* mask;
     size_t size;
+    const PatternSearch* search = nullptr;
 
     const Byte* MaybeFind(Libshit::StringView data) const noexcept;
 
@@ -25,5 +95,34 @@ namespace Neptools
     }
   };
 
+  // Search for multiple patterns in one pass over the data.
+  class PatternSet
+  {
+  public:
+    PatternSet(std::initializer_list<Pattern> patterns);
+
+    // One result for each pattern, in order. Like Pattern::MaybeFind, nullptr
+    // if the pattern is not found or has multiple matches.
+    std::vector<const Byte*> MaybeFind(Libshit::StringView data) const;
+    // Like MaybeFind, but throws if any of the patterns is not found.
+    std::vector<const Byte*> Find(Libshit::StringView data) const;
+
+  private:
+    struct Item
+    {
+      Pattern pattern;
+      // longest run of fully masked bytes in pattern
+      size_t anchor_offset, anchor_size;
+    };
+    std::vector<Item> items;
+    std::vector<size_t> unanchored; // no fully masked byte, check everywhere
+
+    // Aho-Corasick automaton over the anchors, with the failure transitions
+    // already resolved: state*256 + byte -> next state
+    std::vector<std::uint32_t> next;
+    // items whose anchor ends in a given state
+    std::vector<std::vector<std::uint32_t>> out;
+  };
+
 }
 #endif
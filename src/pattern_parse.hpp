@@ -60,12 +60,17 @@ namespace Neptools
       using Append = Pattern<typename PatternBytes::template Append<Pat>,
                              typename MaskBytes::template Append<Mask>>;
 
-      constexpr Pattern() noexcept : ::Neptools::Pattern{pattern, mask, size} {}
+      constexpr Pattern() noexcept
+        : ::Neptools::Pattern{pattern, mask, size, &search} {}
 
       static constexpr auto pattern = PatternBytes::seq;
       static constexpr auto mask    = MaskBytes::seq;
       static constexpr auto size    = PatternBytes::size;
+      static constexpr PatternSearch search =
+        MakePatternSearch(pattern, mask, size);
     };
+    template <typename PatternBytes, typename MaskBytes>
+    constexpr PatternSearch Pattern<PatternBytes, MaskBytes>::search;
 
     template <typename Pat, char... Args> struct PatternParse;
 
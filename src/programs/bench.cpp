@@ -0,0 +1,906 @@
+// End-to-end benchmark on synthetic files: generates deterministic CL3, STCM,
+// GBNL and STSC files, then times parsing, fixup, dumping, inspecting and txt
+// export/import on them. With --io it instead times the basic Source
+// operations with every provider and different chunk sizes. Results are
+// printed as json.
+#include "../format/cl3.hpp"
+#include "../format/gbnl.hpp"
+#include "../format/stcm/collection_link.hpp"
+#include "../format/stcm/data.hpp"
+#include "../format/stcm/exports.hpp"
+#include "../format/stcm/file.hpp"
+#include "../format/stcm/header.hpp"
+#include "../format/stcm/instruction.hpp"
+#include "../format/stsc/file.hpp"
+#include "../format/stsc/header.hpp"
+#include "../low_io.hpp"
+#include "../sink.hpp"
+#include "../txt_serializable.hpp"
+#include "version.hpp"
+
+#include <libshit/except.hpp>
+#include <libshit/options.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <vector>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#define LIBSHIT_LOG_NAME "bench"
+#include <libshit/logger_helper.hpp>
+
+using namespace Neptools;
+using namespace Libshit;
+
+namespace
+{
+  struct Config
+  {
+    uint32_t entries = 64;      // cl3: files in the archive
+    uint32_t links = 4;         // cl3: links per file
+    uint32_t instructions = 20000; // stcm, stsc
+    uint32_t labels = 500;      // stcm: functions, stsc: jump targets
+    uint32_t strings = 2000;    // gbnl: messages, stcm/stsc: string data
+    uint32_t io_size = 16*1024*1024; // --io: size of the test file
+    unsigned iterations = 5;
+    uint32_t seed = 0x4e455054;
+  };
+
+  template <typename T>
+  void Append(std::string& out, const T& t)
+  { out.append(reinterpret_cast<const char*>(&t), sizeof(T)); }
+
+  void AppendLe32(std::string& out, uint32_t x)
+  {
+    char buf[4] = { char(x), char(x >> 8), char(x >> 16), char(x >> 24) };
+    out.append(buf, 4);
+  }
+
+  // Everything is derived from a single mt19937 using raw outputs (and not
+  // std::*_distribution, they're implementation defined), so the same seed
+  // gives the same files everywhere.
+  class Generator
+  {
+  public:
+    Generator(const Config& cfg) : cfg{cfg}, rnd{cfg.seed} {}
+
+    std::string GenGbnl();
+    std::string GenStcm();
+    std::string GenStsc();
+    std::string GenCl3();
+    // NUL terminated strings, offsets receives the start of each
+    std::string GenCStrings(size_t size, std::vector<FilePosition>& offsets);
+
+  private:
+    const Config& cfg;
+    std::mt19937 rnd;
+
+    uint32_t Rand(uint32_t n) { return rnd() % n; }
+    std::string RandomText(size_t min, size_t max);
+    std::string RandomBytes(size_t min, size_t max);
+  };
+
+  std::string Generator::RandomText(size_t min, size_t max)
+  {
+    static const char* const WORDS[] = {
+      "neptune", "noire", "blanc", "vert", "histoire", "compa", "iffy",
+      "plutia", "uzume", "gamindustri", "share", "energy", "the", "a", "is",
+      "and", "of", "pudding", "nepgear", "uni", "rom", "ram",
+    };
+    constexpr auto N = sizeof(WORDS) / sizeof(WORDS[0]);
+
+    auto len = min + Rand(max - min + 1);
+    std::string ret;
+    while (ret.size() < len)
+    {
+      if (!ret.empty()) ret += ' ';
+      ret += WORDS[Rand(N)];
+    }
+    return ret;
+  }
+
+  std::string Generator::RandomBytes(size_t min, size_t max)
+  {
+    std::string ret(min + Rand(max - min + 1), '\0');
+    for (auto& c : ret) c = char(rnd());
+    return ret;
+  }
+
+  static std::string DumpToString(Dumpable& d)
+  {
+    d.Fixup();
+    std::string ret(d.GetSize(), '\0');
+    d.Dump(MemorySink{reinterpret_cast<Byte*>(ret.data()),
+                      FileMemSize(ret.size())});
+    return ret;
+  }
+
+  // {int32 id, string, int32, string} messages
+  std::string Generator::GenGbnl()
+  {
+    Gbnl::Struct::TypeBuilder bld;
+    bld.Add<int32_t>();
+    bld.Add<Gbnl::OffsetString>();
+    bld.Add<int32_t>();
+    bld.Add<Gbnl::OffsetString>();
+    auto type = bld.Build();
+
+    auto gbnl = MakeSmart<Gbnl>(Endian::LITTLE, false, 1, 0, 0, type);
+    gbnl->messages.reserve(cfg.strings);
+    for (uint32_t i = 0; i < cfg.strings; ++i)
+    {
+      auto m = Gbnl::Struct::New(type);
+      m->Get<int32_t>(0) = i;
+      m->Get<Gbnl::OffsetString>(1) = {RandomText(4, 24), 0};
+      m->Get<int32_t>(2) = rnd();
+      m->Get<Gbnl::OffsetString>(3) = {RandomText(16, 160), 0};
+      gbnl->messages.emplace_back(std::move(m));
+    }
+    return DumpToString(*gbnl);
+  }
+
+  // header, collection link header (pointing to EOF), exports (every function
+  // + the gbnl), functions, string data, gbnl data
+  std::string Generator::GenStcm()
+  {
+    using Instr = Stcm::InstructionItem;
+    using Param = Instr::Parameter;
+
+    struct Ins
+    {
+      uint32_t call, opcode; // opcode: function index if call
+      std::vector<std::pair<bool, uint32_t>> params; // mem_offset?, value
+    };
+
+    auto funcs = std::max<uint32_t>(cfg.labels, 1);
+    auto ninstr = std::max(cfg.instructions, funcs);
+    std::vector<std::string> strings;
+    strings.reserve(cfg.strings);
+    for (uint32_t i = 0; i < cfg.strings; ++i)
+      strings.push_back(RandomText(4, 80));
+    auto gbnl = GenGbnl();
+
+    std::vector<std::vector<Ins>> code(funcs);
+    uint32_t next_str = 0;
+    for (uint32_t f = 0; f < funcs; ++f)
+    {
+      auto n = ninstr / funcs + (f < ninstr % funcs);
+      code[f].reserve(n);
+      for (uint32_t i = 0; i + 1 < n; ++i)
+      {
+        Ins ins;
+        if (Rand(8) == 0)
+          ins = {1, Rand(funcs), {}};
+        else
+        {
+          // 0 and 6 don't return
+          uint32_t oc;
+          do oc = 1 + Rand(Instr::Header::USER_OPCODES - 1); while (oc == 6);
+          ins = {0, oc, {}};
+        }
+        for (uint32_t p = Rand(4); p; --p)
+          if (!strings.empty() && Rand(2))
+            ins.params.emplace_back(true, next_str++ % strings.size());
+          else
+            ins.params.emplace_back(false, Rand(1000));
+        code[f].push_back(std::move(ins));
+      }
+      code[f].push_back({0, 0, {}});
+    }
+
+    // layout
+    FilePosition pos = sizeof(Stcm::HeaderItem::Header) +
+      sizeof(Stcm::CollectionLinkHeaderItem::Header);
+    auto exports_pos = pos;
+    pos += (funcs + 1) * sizeof(Stcm::ExportsItem::Entry);
+
+    std::vector<FilePosition> func_pos;
+    func_pos.reserve(funcs);
+    for (const auto& f : code)
+    {
+      func_pos.push_back(pos);
+      for (const auto& i : f)
+        pos += sizeof(Instr::Header) + i.params.size() * sizeof(Param);
+    }
+
+    std::vector<FilePosition> str_pos;
+    str_pos.reserve(strings.size());
+    for (const auto& s : strings)
+    {
+      str_pos.push_back(pos);
+      pos += sizeof(Stcm::DataItem::Header) + (s.size() + 1 + 3) / 4 * 4;
+    }
+    auto gbnl_pos = pos;
+    pos += sizeof(Stcm::DataItem::Header) + gbnl.size();
+    auto file_size = pos;
+
+    // write
+    std::string out;
+    out.reserve(file_size);
+
+    Stcm::HeaderItem::Header hdr{};
+    memcpy(hdr.magic, "STCM2", 5);
+    hdr.endian = 'L';
+    hdr.export_offset = exports_pos;
+    hdr.export_count = funcs + 1;
+    hdr.collection_link_offset = sizeof(hdr);
+    Append(out, hdr);
+
+    Stcm::CollectionLinkHeaderItem::Header clh{};
+    clh.offset = file_size;
+    Append(out, clh);
+
+    for (uint32_t f = 0; f <= funcs; ++f)
+    {
+      Stcm::ExportsItem::Entry e{};
+      char name[0x20];
+      if (f < funcs)
+      {
+        snprintf(name, sizeof(name), "func_%u", unsigned(f));
+        e.type = uint32_t(Stcm::ExportsItem::Type::CODE);
+        e.offset = func_pos[f];
+      }
+      else
+      {
+        strcpy(name, "messages");
+        e.type = uint32_t(Stcm::ExportsItem::Type::DATA);
+        e.offset = gbnl_pos;
+      }
+      e.name = name;
+      Append(out, e);
+    }
+
+    for (const auto& f : code)
+      for (const auto& i : f)
+      {
+        Instr::Header ih;
+        ih.is_call = i.call;
+        ih.opcode = i.call ? func_pos[i.opcode] : i.opcode;
+        ih.param_count = i.params.size();
+        ih.size = sizeof(Instr::Header) + i.params.size() * sizeof(Param);
+        Append(out, ih);
+
+        for (const auto& [mem, val] : i.params)
+        {
+          Param p;
+          if (mem)
+          {
+            p.param_0 = Param::Tag(Param::Type0::MEM_OFFSET, str_pos[val]);
+            p.param_4 = Param::Tag(Param::Type48::IMMEDIATE, 0);
+          }
+          else
+          {
+            p.param_0 = Param::Tag(Param::Type0::INDIRECT, val % 256);
+            p.param_4 = 0x40000000;
+          }
+          p.param_8 = Param::Tag(Param::Type48::IMMEDIATE, val);
+          Append(out, p);
+        }
+      }
+
+    for (const auto& s : strings)
+    {
+      auto len = (s.size() + 1 + 3) / 4 * 4;
+      Stcm::DataItem::Header dh;
+      dh.type = 0;
+      dh.offset_unit = len / 4;
+      dh.field_8 = 1;
+      dh.length = len;
+      Append(out, dh);
+      out += s;
+      out.append(len - s.size(), '\0');
+    }
+
+    Stcm::DataItem::Header dh;
+    dh.type = 0;
+    dh.offset_unit = 1;
+    dh.field_8 = 0;
+    dh.length = gbnl.size();
+    Append(out, dh);
+    out += gbnl;
+
+    LIBSHIT_ASSERT(out.size() == file_size);
+    return out;
+  }
+
+  // NOIRE flavor: 0e (string), 05 (u32), 12 (u32, u8), 06 (jump), 01 at end,
+  // strings after the code
+  std::string Generator::GenStsc()
+  {
+    auto ninstr = std::max<uint32_t>(cfg.instructions, 1);
+    std::vector<std::string> strings;
+    strings.reserve(cfg.strings);
+    for (uint32_t i = 0; i < cfg.strings; ++i)
+      strings.push_back(RandomText(4, 80));
+
+    std::vector<uint32_t> targets(std::max<uint32_t>(cfg.labels, 1));
+    for (auto& t : targets) t = Rand(ninstr);
+
+    struct Ins { uint8_t opcode; uint32_t val; };
+    std::vector<Ins> code;
+    code.reserve(ninstr);
+    uint32_t next_str = 0;
+    for (uint32_t i = 0; i + 1 < ninstr; ++i)
+    {
+      auto r = Rand(8);
+      if (r < 3 && !strings.empty())
+        code.push_back({0x0e, uint32_t(next_str++ % strings.size())});
+      else if (r == 3)
+        code.push_back({0x06, targets[Rand(targets.size())]});
+      else if (r < 6)
+        code.push_back({0x05, uint32_t(rnd())});
+      else
+        code.push_back({0x12, uint32_t(rnd())});
+    }
+    code.push_back({0x01, 0});
+
+    // layout
+    FilePosition pos = sizeof(Stsc::HeaderItem::Header);
+    std::vector<FilePosition> code_pos;
+    code_pos.reserve(code.size());
+    for (const auto& i : code)
+    {
+      code_pos.push_back(pos);
+      pos += i.opcode == 0x01 ? 1 : i.opcode == 0x12 ? 6 : 5;
+    }
+    std::vector<FilePosition> str_pos;
+    str_pos.reserve(strings.size());
+    for (const auto& s : strings)
+    {
+      str_pos.push_back(pos);
+      pos += s.size() + 1;
+    }
+
+    std::string out;
+    out.reserve(pos);
+    Stsc::HeaderItem::Header hdr;
+    memcpy(hdr.magic, "STSC", 4);
+    hdr.entry_point = sizeof(hdr);
+    hdr.flags = 0;
+    Append(out, hdr);
+
+    for (const auto& i : code)
+    {
+      out += char(i.opcode);
+      switch (i.opcode)
+      {
+      case 0x0e: AppendLe32(out, str_pos[i.val]); break;
+      case 0x06: AppendLe32(out, code_pos[i.val]); break;
+      case 0x05: AppendLe32(out, i.val); break;
+      case 0x12: AppendLe32(out, i.val); out += char(i.val >> 8); break;
+      }
+    }
+    for (const auto& s : strings)
+      out.append(s.c_str(), s.size() + 1);
+
+    LIBSHIT_ASSERT(out.size() == pos);
+    return out;
+  }
+
+  // main.DAT is an stcm, the rest are random blobs
+  std::string Generator::GenCl3()
+  {
+    auto cl3 = MakeSmart<Cl3>();
+    auto n = std::max<uint32_t>(cfg.entries, 1);
+    cl3->entries.reserve(n);
+    for (uint32_t i = 0; i < n; ++i)
+    {
+      std::string name;
+      std::string data;
+      if (i == 0)
+      {
+        name = "main.DAT";
+        data = GenStcm();
+      }
+      else
+      {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "file_%04u.bin", unsigned(i));
+        name = buf;
+        data = RandomBytes(256, 4096);
+      }
+
+      auto& e = cl3->GetOrCreateFile(name);
+      e.src = MakeSmart<DumpableSource>(
+        Source::FromMemory(name, std::move(data)));
+    }
+
+    for (auto& e : cl3->entries)
+      for (uint32_t i = 0; i < cfg.links; ++i)
+        e.links.push_back(&cl3->entries[Rand(n)]);
+
+    return DumpToString(*cl3);
+  }
+
+  std::string Generator::GenCStrings(
+    size_t size, std::vector<FilePosition>& offsets)
+  {
+    std::string ret;
+    ret.reserve(size + 256);
+    while (ret.size() < size)
+    {
+      offsets.push_back(ret.size());
+      ret += RandomText(8, 200);
+      ret += '\0';
+    }
+    return ret;
+  }
+
+  struct Format
+  {
+    const char* name;
+    std::string (Generator::*gen)();
+    SmartPtr<Dumpable> (*parse)(Source src);
+    TxtSerializable& (*txt)(Dumpable& d);
+  };
+
+  const Format FORMATS[] = {
+    {
+      "cl3", &Generator::GenCl3,
+      [](Source src) -> SmartPtr<Dumpable>
+      {
+        auto ret = MakeSmart<Cl3>(std::move(src));
+        ret->GetStcm();
+        return ret;
+      },
+      [](Dumpable& d) -> TxtSerializable&
+      { return static_cast<Cl3&>(d).GetStcm(); },
+    },
+    {
+      "stcm", &Generator::GenStcm,
+      [](Source src) -> SmartPtr<Dumpable>
+      { return MakeSmart<Stcm::File>(std::move(src)); },
+      [](Dumpable& d) -> TxtSerializable&
+      { return static_cast<Stcm::File&>(d); },
+    },
+    {
+      "gbnl", &Generator::GenGbnl,
+      [](Source src) -> SmartPtr<Dumpable>
+      { return MakeSmart<Gbnl>(std::move(src)); },
+      [](Dumpable& d) -> TxtSerializable&
+      { return static_cast<Gbnl&>(d); },
+    },
+    {
+      "stsc", &Generator::GenStsc,
+      [](Source src) -> SmartPtr<Dumpable>
+      { return MakeSmart<Stsc::File>(std::move(src), Stsc::Flavor::NOIRE); },
+      [](Dumpable& d) -> TxtSerializable&
+      { return static_cast<Stsc::File&>(d); },
+    },
+  };
+
+#define NEPTOOLS_BENCH_PHASES(x)                                         \
+  x(PARSE, "parse") x(FIXUP, "fixup") x(DUMP, "dump")                   \
+  x(INSPECT, "inspect") x(WRITE_TXT, "write_txt") x(READ_TXT, "read_txt")
+
+  enum class Phase
+  {
+#define NEPTOOLS_GEN_ENUM(x, y) x,
+    NEPTOOLS_BENCH_PHASES(NEPTOOLS_GEN_ENUM)
+#undef NEPTOOLS_GEN_ENUM
+    COUNT,
+  };
+
+  const char* const PHASE_NAMES[] = {
+#define NEPTOOLS_GEN_NAME(x, y) y,
+    NEPTOOLS_BENCH_PHASES(NEPTOOLS_GEN_NAME)
+#undef NEPTOOLS_GEN_NAME
+  };
+
+  struct Result
+  {
+    const char* format;
+    size_t size;
+    uint64_t hash;
+    size_t txt_size = 0;
+    bool roundtrip = true;
+    std::vector<double> times[size_t(Phase::COUNT)];
+  };
+
+  // FNV-1a, to tell whether two runs used the same corpus
+  uint64_t Hash(const std::string& str)
+  {
+    uint64_t h = 0xcbf29ce484222325;
+    for (unsigned char c : str) h = (h ^ c) * 0x100000001b3;
+    return h;
+  }
+
+  template <typename Fun>
+  void Time(std::vector<double>& out, Fun f)
+  {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    out.push_back(std::chrono::duration<double>(end - start).count());
+  }
+
+  Result Run(const Format& fmt, const std::string& data, unsigned iterations)
+  {
+    Result res{fmt.name, data.size(), Hash(data)};
+    for (unsigned i = 0; i < iterations; ++i)
+    {
+      auto src = Source::FromMemory(fmt.name, data);
+      SmartPtr<Dumpable> dump;
+      auto t = [&](Phase p, auto f) { Time(res.times[size_t(p)], f); };
+
+      t(Phase::PARSE, [&]() { dump = fmt.parse(src); });
+      t(Phase::FIXUP, [&]() { dump->Fixup(); });
+
+      std::string out(dump->GetSize(), '\0');
+      MemorySink sink{reinterpret_cast<Byte*>(out.data()),
+                      FileMemSize(out.size())};
+      t(Phase::DUMP, [&]() { dump->Dump(sink); });
+      if (i == 0 && out != data)
+      {
+        WARN << fmt.name << ": dumped file differs from the input" << std::endl;
+        res.roundtrip = false;
+      }
+
+      std::ostringstream inspect;
+      t(Phase::INSPECT, [&]() { dump->Inspect(inspect); });
+
+      auto& txt = fmt.txt(*dump);
+      std::ostringstream txt_os;
+      t(Phase::WRITE_TXT, [&]() { txt.WriteTxt(txt_os); });
+      auto txt_str = txt_os.str();
+      res.txt_size = txt_str.size();
+      std::istringstream txt_is{std::move(txt_str)};
+      t(Phase::READ_TXT, [&]() { txt.ReadTxt(txt_is); });
+    }
+    return res;
+  }
+
+  // --io: same file through every provider, with fixed chunk sizes and the
+  // default adaptive ones
+  struct IoCorpus
+  {
+    std::string data;
+    std::vector<FilePosition> strings; // shuffled string offsets
+    std::vector<FilePosition> randoms; // random uint32 offsets
+  };
+
+  // prevent the compiler from optimizing away the reads
+  volatile uint64_t io_sink;
+
+  const struct IoWorkload
+  {
+    const char* name;
+    uint64_t (*fun)(Source& src, const IoCorpus& corp); // returns bytes read
+  } IO_WORKLOADS[] = {
+    {
+      "read_gen_seq", [](Source& src, const IoCorpus&) -> uint64_t
+      {
+        uint64_t sum = 0;
+        auto n = src.GetSize() / 4;
+        for (FilePosition i = 0; i < n; ++i)
+          sum += src.ReadGen<uint32_t>();
+        io_sink = sum;
+        return n * 4;
+      },
+    },
+    {
+      "read_gen_random", [](Source& src, const IoCorpus& corp) -> uint64_t
+      {
+        uint64_t sum = 0;
+        for (auto o : corp.randoms) sum += src.PreadGen<uint32_t>(o);
+        io_sink = sum;
+        return corp.randoms.size() * 4;
+      },
+    },
+    {
+      "get_chunk", [](Source& src, const IoCorpus&) -> uint64_t
+      {
+        uint64_t sum = 0;
+        for (FilePosition o = 0; o < src.GetSize(); )
+        {
+          auto ch = src.GetChunk(o);
+          sum += static_cast<unsigned char>(ch[0]);
+          o += ch.size();
+        }
+        io_sink = sum;
+        return src.GetSize();
+      },
+    },
+    {
+      "pread_cstring", [](Source& src, const IoCorpus& corp) -> uint64_t
+      {
+        uint64_t sum = 0;
+        for (auto o : corp.strings) sum += src.PreadCString(o).size() + 1;
+        io_sink = sum;
+        return sum;
+      },
+    },
+    {
+      "dump", [](Source& src, const IoCorpus&) -> uint64_t
+      {
+        std::unique_ptr<Byte[]> buf{new Byte[src.GetSize()]};
+        src.Dump(MemorySink{buf.get(), src.GetSize()});
+        io_sink = buf[src.GetSize() / 2];
+        return src.GetSize();
+      },
+    },
+  };
+
+  struct IoResult
+  {
+    const char* provider;
+    FileMemSize chunk; // 0: default adaptive sizes
+    const char* workload;
+    uint64_t bytes;
+    std::vector<double> times;
+  };
+
+  std::vector<IoResult> RunIo(const Config& cfg)
+  {
+    Generator gen{cfg};
+    std::mt19937 rnd{cfg.seed};
+    IoCorpus corp;
+    corp.data = gen.GenCStrings(cfg.io_size, corp.strings);
+    for (size_t i = corp.strings.size(); i > 1; --i) // fisher-yates
+      std::swap(corp.strings[i-1], corp.strings[rnd() % i]);
+    if (corp.data.size() >= 4)
+      for (size_t i = 0; i < corp.data.size() / 256; ++i)
+        corp.randoms.push_back(rnd() % (corp.data.size() - 3));
+
+    auto fname = boost::filesystem::temp_directory_path() /
+      boost::filesystem::unique_path("neptools-bench-%%%%-%%%%-%%%%");
+    struct Remove
+    {
+      boost::filesystem::path p;
+      ~Remove()
+      {
+        boost::system::error_code ec;
+        boost::filesystem::remove(p, ec);
+      }
+    } rm{fname};
+    {
+      auto sink = Sink::ToFile(fname, corp.data.size());
+      sink->Write(corp.data);
+      sink->Flush();
+    }
+    LowIo io{fname.c_str(), false};
+
+    using PT = Source::ProviderType;
+    struct Provider
+    {
+      const char* name;
+      std::optional<PT> type;
+      std::vector<FileMemSize> chunks;
+      std::function<Source ()> open;
+    } providers[] = {
+      { "memory", {}, {}, [&]() { return Source::FromMemory(corp.data); } },
+      { "mmap", PT::MMAP, {64*1024, 256*1024, 1024*1024, 4*1024*1024},
+        [&]() { return Source::FromFile(fname); } },
+      { "unix", PT::UNIX, {4*1024, 16*1024, 64*1024, 256*1024, 1024*1024},
+        [&]() { return Source::FromFd(fname, io.fd, false); } },
+    };
+
+    std::vector<IoResult> ret;
+    for (const auto& p : providers)
+    {
+      std::optional<Source::ChunkSizes> orig;
+      if (p.type) orig = Source::GetChunkSizes(*p.type);
+      try
+      {
+        // first with the default adaptive sizes, then the fixed ones
+        for (size_t i = 0; i <= p.chunks.size(); ++i)
+        {
+          FileMemSize chunk = i ? p.chunks[i-1] : 0;
+          if (p.type)
+            Source::SetChunkSizes(
+              *p.type, chunk ? Source::ChunkSizes{chunk, chunk, chunk} : *orig);
+
+          for (const auto& w : IO_WORKLOADS)
+          {
+            INF << "Running " << p.name << ' ' << w.name << ", chunk: "
+                << (chunk ? std::to_string(chunk) : "adaptive") << std::endl;
+            IoResult res{p.name, chunk, w.name, 0, {}};
+            for (unsigned it = 0; it < cfg.iterations; ++it)
+            {
+              auto src = p.open(); // new source, so nothing is cached
+              Time(res.times, [&]() { res.bytes = w.fun(src, corp); });
+            }
+            ret.push_back(std::move(res));
+          }
+        }
+      }
+      catch (...)
+      {
+        if (orig) Source::SetChunkSizes(*p.type, *orig);
+        throw;
+      }
+      if (orig) Source::SetChunkSizes(*p.type, *orig);
+    }
+    return ret;
+  }
+
+  void WriteTimes(std::ostream& os, const std::vector<double>& t, double bytes)
+  {
+    auto min = *std::min_element(t.begin(), t.end());
+    auto max = *std::max_element(t.begin(), t.end());
+    double sum = 0;
+    for (auto x : t) sum += x;
+    auto mean = sum / t.size();
+
+    os << "{\"min\": " << min << ", \"mean\": " << mean
+       << ", \"max\": " << max << ", \"mib_per_s\": "
+       << (min > 0 ? bytes / min / (1024*1024) : 0) << '}';
+  }
+
+  void WriteJson(std::ostream& os, const Config& cfg,
+                 const std::vector<Result>& results,
+                 const std::vector<IoResult>& io_results)
+  {
+    os << std::setprecision(9)
+       << "{\n  \"version\": \"" NEPTOOLS_VERSION "\",\n"
+       << "  \"config\": {\"seed\": " << cfg.seed
+       << ", \"iterations\": " << cfg.iterations
+       << ", \"entries\": " << cfg.entries
+       << ", \"links\": " << cfg.links
+       << ", \"instructions\": " << cfg.instructions
+       << ", \"labels\": " << cfg.labels
+       << ", \"strings\": " << cfg.strings
+       << ", \"io_size\": " << cfg.io_size << "},\n"
+       << "  \"results\": [";
+
+    bool first_res = true;
+    for (const auto& r : results)
+    {
+      os << (first_res ? "\n" : ",\n")
+         << "    {\"format\": \"" << r.format << "\", \"size\": " << r.size
+         << ", \"hash\": \"" << std::hex << std::setw(16) << std::setfill('0')
+         << r.hash << std::dec << std::setfill(' ')
+         << "\", \"txt_size\": " << r.txt_size
+         << ", \"roundtrip\": " << (r.roundtrip ? "true" : "false")
+         << ", \"phases\": {";
+      first_res = false;
+
+      for (size_t p = 0; p < size_t(Phase::COUNT); ++p)
+      {
+        if (r.times[p].empty()) continue;
+        os << (p ? ",\n" : "\n") << "      \"" << PHASE_NAMES[p] << "\": ";
+        WriteTimes(os, r.times[p], r.size); // speed relative to the input
+      }
+      os << "}}";
+    }
+
+    os << "\n  ],\n  \"io\": [";
+    bool first_io = true;
+    for (const auto& r : io_results)
+    {
+      if (r.times.empty()) continue;
+      os << (first_io ? "\n" : ",\n")
+         << "    {\"provider\": \"" << r.provider << "\", \"chunk\": ";
+      if (r.chunk) os << r.chunk;
+      else os << "\"adaptive\"";
+      os << ", \"workload\": \"" << r.workload << "\", \"bytes\": "
+         << r.bytes << ", \"times\": ";
+      WriteTimes(os, r.times, r.bytes);
+      os << '}';
+      first_io = false;
+    }
+    os << "\n  ]\n}\n";
+  }
+}
+
+int main(int argc, char** argv)
+{
+  Config cfg;
+  std::vector<const Format*> formats;
+  const char* output = nullptr;
+  const char* corpus_dir = nullptr;
+  bool io = false;
+
+  auto& parser = OptionParser::GetGlobal();
+  OptionGroup grp{parser, "Benchmark options"};
+
+  auto num = [](auto& dst)
+  {
+    return [&dst](auto&& args)
+    {
+      try { dst = std::stoul(args.front()); }
+      catch (const std::exception&) { throw InvalidParam{"invalid number"}; }
+    };
+  };
+
+  Option entries_opt{grp, "entries", 1, "N", "Number of files in the cl3",
+                     num(cfg.entries)};
+  Option links_opt{grp, "links", 1, "N", "Number of links per cl3 file",
+                   num(cfg.links)};
+  Option instrs_opt{grp, "instructions", 1, "N",
+                    "Number of instructions in the stcm and stsc",
+                    num(cfg.instructions)};
+  Option labels_opt{grp, "labels", 1, "N",
+                    "Number of functions in the stcm, jump targets in the stsc",
+                    num(cfg.labels)};
+  Option strings_opt{grp, "strings", 1, "N",
+                     "Number of gbnl messages, stcm and stsc strings",
+                     num(cfg.strings)};
+  Option iter_opt{grp, "iterations", 'n', 1, "N",
+                  "Repeat every measurement N times", num(cfg.iterations)};
+  Option seed_opt{grp, "seed", 1, "N", "Seed of the generator", num(cfg.seed)};
+  Option format_opt{
+    grp, "format", 'f', 1, "FORMAT",
+    "Only benchmark FORMAT (cl3, stcm, gbnl or stsc), can be repeated",
+    [&](auto&& args)
+    {
+      for (const auto& f : FORMATS)
+        if (strcmp(f.name, args.front()) == 0)
+        {
+          formats.push_back(&f);
+          return;
+        }
+      throw InvalidParam{"invalid format"};
+    }};
+  Option output_opt{grp, "output", 'o', 1, "FILE",
+                    "Write json results to FILE instead of stdout",
+                    [&](auto&& args) { output = args.front(); }};
+  Option corpus_opt{grp, "save-corpus", 1, "DIR",
+                    "Also save the generated files into DIR",
+                    [&](auto&& args) { corpus_dir = args.front(); }};
+  Option io_opt{grp, "io", 0, nullptr,
+                "Run the Source I/O benchmarks instead of the file formats",
+                [&](auto&&) { io = true; }};
+  Option io_size_opt{grp, "io-size", 1, "BYTES",
+                     "Size of the test file of --io", num(cfg.io_size)};
+
+  parser.SetVersion("NepTools bench v" NEPTOOLS_VERSION);
+  parser.SetUsage("[--options]");
+
+  try
+  {
+    parser.Run(argc, argv);
+    if (formats.empty() && !io)
+      for (const auto& f : FORMATS) formats.push_back(&f);
+
+    std::vector<Result> results;
+    std::vector<IoResult> io_results;
+    if (io) io_results = RunIo(cfg);
+    for (auto f : formats)
+    {
+      // new generator for every format, so the files don't depend on which
+      // other formats were selected
+      Generator gen{cfg};
+      auto data = (gen.*f->gen)();
+      if (corpus_dir)
+      {
+        boost::filesystem::path dir{corpus_dir};
+        boost::filesystem::create_directories(dir);
+        auto sink = Sink::ToFile(dir / (std::string{"bench."} + f->name),
+                                 data.size());
+        sink->Write(data);
+        sink->Flush();
+      }
+
+      INF << "Running " << f->name << " (" << data.size() << " bytes)"
+          << std::endl;
+      results.push_back(Run(*f, data, cfg.iterations));
+    }
+
+    if (output)
+    {
+      std::ofstream os{output};
+      os.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+      WriteJson(os, cfg, results, io_results);
+    }
+    else
+      WriteJson(std::cout, cfg, results, io_results);
+  }
+  catch (const Exit& e) { return !e.success; }
+  catch (...)
+  {
+    ERR << "Fatal error, aborting\n" << ExceptionToString() << std::endl;
+    return 2;
+  }
+  return 0;
+}
@@ -5,7 +5,10 @@
 #include "../format/stcm/gbnl.hpp"
 #include "../format/stcm/string_data.hpp"
 #include "../format/stsc/file.hpp"
+#include "../memory_usage.hpp"
 #include "../open.hpp"
+#include "../stats.hpp"
+#include "../trace.hpp"
 #include "../txt_serializable.hpp"
 #include "../utils.hpp"
 #include "version.hpp"
@@ -18,6 +21,11 @@
 #include <iostream>
 #include <fstream>
 #include <deque>
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <vector>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/operations.hpp>
@@ -28,6 +36,20 @@
 #  include <io.h>
 #endif
 
+#if !LIBSHIT_OS_IS_WINDOWS
+#  include <cerrno>
+#  include <csignal>
+#  include <cstring>
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <sys/stat.h>
+#  include <sys/un.h>
+#  include <unistd.h>
+#endif
+
+#include <libshit/doctest.hpp>
+
 #define LIBSHIT_LOG_NAME "stcm-editor"
 #include <libshit/logger_helper.hpp>
 
@@ -45,27 +67,159 @@ namespace
   };
 }
 
+// in server mode keep parsed files around until they change on disk
+namespace
+{
+  struct FileStamp
+  {
+    std::uint64_t mtime_ns;
+    std::uintmax_t size;
+    bool operator==(const FileStamp& o) const noexcept
+    { return mtime_ns == o.mtime_ns && size == o.size; }
+    bool operator!=(const FileStamp& o) const noexcept { return !(*this == o); }
+  };
+
+  struct OpenCacheEntry
+  {
+    FileStamp stamp;
+    SmartPtr<Dumpable> dump;
+    std::size_t mem_size;
+    std::uint64_t last_use;
+  };
+}
+static bool keep_open = false;
+static std::map<boost::filesystem::path, OpenCacheEntry> open_cache;
+static std::size_t open_cache_limit = 512*1024*1024;
+static std::size_t open_cache_size = 0;
+static std::uint64_t open_cache_clock = 0;
+
+// last_write_time only has second resolution, a file rewritten in the same
+// second with the same size would look unchanged
+static FileStamp GetFileStamp(const boost::filesystem::path& fname)
+{
+#if LIBSHIT_OS_IS_WINDOWS
+  return {
+    std::uint64_t(boost::filesystem::last_write_time(fname)) * 1000000000,
+    boost::filesystem::file_size(fname)};
+#else
+  struct stat buf;
+  if (stat(fname.c_str(), &buf) < 0)
+    LIBSHIT_THROW(SystemError, std::error_code{errno, std::system_category()},
+                  "API function", "stat", "File", fname);
+#  ifdef __APPLE__
+  auto& ts = buf.st_mtimespec;
+#  else
+  auto& ts = buf.st_mtim;
+#  endif
+  return {std::uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec,
+          std::uintmax_t(buf.st_size)};
+#endif
+}
+
+// the same file can be reached through different (relative, symlinked)
+// paths, don't parse it twice
+static boost::filesystem::path OpenCacheKey(const boost::filesystem::path& fname)
+{
+  boost::system::error_code ec;
+  auto ret = boost::filesystem::canonical(fname, ec);
+  return ec ? boost::filesystem::absolute(fname) : ret;
+}
+
+static std::size_t OpenCacheMemSize(const Dumpable& dmp)
+{
+  MemoryUsage mu;
+  dmp.GetMemoryUsage(mu);
+  return mu.GetTotal();
+}
+
+static void OpenCacheErase(
+  std::map<boost::filesystem::path, OpenCacheEntry>::iterator it)
+{
+  open_cache_size -= it->second.mem_size;
+  open_cache.erase(it);
+}
+
+static void OpenCacheErase(const boost::filesystem::path& fname)
+{
+  auto it = open_cache.find(OpenCacheKey(fname));
+  if (it != open_cache.end()) OpenCacheErase(it);
+}
+
+// drop least recently used files until under the limit, except the most
+// recent one
+static void OpenCacheEvict()
+{
+  while (open_cache_size > open_cache_limit && open_cache.size() > 1)
+  {
+    auto lru = std::min_element(
+      open_cache.begin(), open_cache.end(), [](auto& a, auto& b)
+      { return a.second.last_use < b.second.last_use; });
+    OpenCacheErase(lru);
+  }
+}
+
 static State SmartOpen(const boost::filesystem::path& fname)
 {
-  auto x = OpenFactory::Open(fname);
+  Trace::Scope tr{"open", fname};
+  SmartPtr<Dumpable> x;
+  if (keep_open)
+  {
+    auto key = OpenCacheKey(fname);
+    auto stamp = GetFileStamp(key);
+    auto it = open_cache.find(key);
+    if (it != open_cache.end() && it->second.stamp != stamp)
+    {
+      OpenCacheErase(it);
+      it = open_cache.end();
+    }
+    if (it == open_cache.end())
+    {
+      // only insert after a successful open
+      auto dump = OpenFactory::Open(key);
+      auto mem_size = OpenCacheMemSize(*dump);
+      it = open_cache.emplace(
+        key, OpenCacheEntry{stamp, std::move(dump), mem_size, 0}).first;
+      open_cache_size += mem_size;
+    }
+    it->second.last_use = ++open_cache_clock;
+    x = it->second.dump;
+    OpenCacheEvict();
+  }
+  else
+    x = OpenFactory::Open(fname);
+
   return {x, dynamic_cast<Cl3*>(x.get()), dynamic_cast<Stcm::File*>(x.get()),
       dynamic_cast<TxtSerializable*>(x.get())};
 }
 
+// call after dumping a cached file to fname
+static void OpenCacheSaved(const boost::filesystem::path& fname)
+{
+  auto it = open_cache.find(OpenCacheKey(fname));
+  if (it == open_cache.end()) return;
+  it->second.stamp = GetFileStamp(it->first);
+  open_cache_size -= it->second.mem_size;
+  it->second.mem_size = OpenCacheMemSize(*it->second.dump);
+  open_cache_size += it->second.mem_size;
+  OpenCacheEvict();
+}
+
 template <typename T>
 static void ShellDump(const T* item, const char* name)
 {
+  Trace::Scope tr{"save", name};
   RefCountedPtr<Sink> sink;
   if (name[0] == '-' && name[1] == '\0')
     sink = Sink::ToStdOut();
   else
-    sink = Sink::ToFile(name, item->GetSize());
+    sink = Sink::ToGrowingFile(name);
   item->Dump(*sink);
 }
 
 template <typename T, typename Fun>
 static void ShellInspectGen(const T* item, const char* name, Fun f)
 {
+  Trace::Scope tr{"inspect", name};
   if (name[0] == '-' && name[1] == '\0')
     f(item, std::cout);
   else
@@ -98,6 +252,32 @@ static void EnsureTxt(State& st)
   st.txt = st.stcm;
 }
 
+// --stats: keep the memory usage of the largest file processed
+static bool stats = false;
+static MemoryUsage stats_memory;
+static std::string stats_memory_file;
+
+static void StatsMemory(const std::string& name, const Dumpable& dmp)
+{
+  if (!stats) return;
+  MemoryUsage mu;
+  dmp.GetMemoryUsage(mu);
+  if (mu.GetTotal() > stats_memory.GetTotal())
+  {
+    stats_memory = std::move(mu);
+    stats_memory_file = name;
+  }
+}
+
+static void PrintStats()
+{
+  Stats::Print(std::cerr);
+  if (stats_memory_file.empty()) return;
+  std::cerr << "Memory usage of the largest file (" << stats_memory_file
+            << "):\n";
+  stats_memory.Print(std::cerr);
+}
+
 static bool auto_failed = false;
 template <typename Pred, typename Fun>
 static void RecDo(
@@ -105,7 +285,11 @@ static void RecDo(
 {
   if (p(path, rec))
   {
-    try { f(path); }
+    try
+    {
+      Trace::Scope tr{"auto", path};
+      f(path);
+    }
     catch (const std::exception& e)
     {
       auto_failed = true;
@@ -119,6 +303,191 @@ static void RecDo(
     ERR << "Invalid filename: " << path << std::endl;
 }
 
+// --manifest: skip auto operations where none of the involved files changed
+// since the last successful run
+namespace
+{
+  struct ManifestFile
+  {
+    boost::filesystem::path path;
+    std::uintmax_t size;
+    std::time_t mtime;
+    std::uint64_t hash;
+  };
+  using ManifestFiles = std::vector<ManifestFile>;
+}
+static boost::filesystem::path manifest_path;
+static std::map<std::string, ManifestFiles> manifest;
+
+static constexpr const char MANIFEST_MAGIC[] = "neptools-manifest 1";
+
+static void LoadManifest()
+{
+  manifest.clear();
+  if (!boost::filesystem::exists(manifest_path)) return;
+
+  auto is = OpenIn(manifest_path);
+  std::string line;
+  if (!std::getline(is, line) || line != MANIFEST_MAGIC)
+  {
+    WARN << "Ignoring invalid manifest " << manifest_path << std::endl;
+    return;
+  }
+
+  ManifestFiles* files = nullptr;
+  while (std::getline(is, line))
+  {
+    if (line.empty()) continue;
+    if (line[0] == '@')
+    {
+      files = &manifest[line.substr(1)];
+      continue;
+    }
+
+    std::istringstream ss{line};
+    ManifestFile f;
+    ss >> std::hex >> f.hash >> std::dec >> f.size >> f.mtime;
+    ss.get();
+    std::string path;
+    std::getline(ss, path);
+    if (!ss || !files)
+      LIBSHIT_THROW(DecodeError, "Invalid manifest line", "Line", line);
+    f.path = path;
+    files->push_back(std::move(f));
+  }
+}
+
+static void SaveManifest()
+{
+  auto tmp = manifest_path;
+  tmp += ".tmp";
+  {
+    auto os = OpenOut(tmp);
+    os << MANIFEST_MAGIC << '\n';
+    for (const auto& [key, files] : manifest)
+    {
+      os << '@' << key << '\n';
+      for (const auto& f : files)
+        os << std::hex << std::setw(16) << std::setfill('0') << f.hash
+           << std::dec << ' ' << f.size << ' ' << f.mtime << ' '
+           << f.path.string() << '\n';
+    }
+  }
+  boost::filesystem::rename(tmp, manifest_path);
+}
+
+// 64-bit FNV-1a hash of the file's contents
+static std::uint64_t HashFile(const boost::filesystem::path& path)
+{
+  auto src = Source::FromFile(path);
+  std::uint64_t h = 0xcbf29ce484222325;
+  for (FilePosition offs = 0, size = src.GetSize(); offs < size; )
+  {
+    auto chunk = src.GetChunk(offs);
+    for (unsigned char c : chunk)
+      h = (h ^ c) * 0x100000001b3;
+    offs += chunk.size();
+  }
+  return h;
+}
+
+// regular files at path (recursively if it's a directory), sorted
+static void ListFiles(
+  const boost::filesystem::path& path, std::vector<boost::filesystem::path>& out)
+{
+  if (boost::filesystem::is_directory(path))
+  {
+    auto begin = out.size();
+    for (auto& e : boost::filesystem::recursive_directory_iterator(path))
+      if (boost::filesystem::is_regular_file(e.status()))
+        out.push_back(e.path());
+    std::sort(out.begin() + begin, out.end());
+  }
+  else if (boost::filesystem::exists(path))
+    out.push_back(path);
+}
+
+// Same size and mtime is considered unchanged without hashing. If need_hash is
+// false, returns as soon as a difference is certain.
+static bool ManifestFileMatches(
+  const ManifestFile& old, ManifestFile& cur, bool need_hash)
+{
+  if (old.path != cur.path) return false;
+  if (old.size == cur.size && old.mtime == cur.mtime)
+  {
+    cur.hash = old.hash;
+    return true;
+  }
+  if (old.size != cur.size && !need_hash) return false;
+
+  cur.hash = HashFile(cur.path);
+  return old.size == cur.size && old.hash == cur.hash;
+}
+
+static ManifestFiles ManifestState(
+  const std::vector<boost::filesystem::path>& roots, const ManifestFiles* old,
+  bool& up_to_date, bool need_hash)
+{
+  std::vector<boost::filesystem::path> paths;
+  for (const auto& r : roots) ListFiles(r, paths);
+
+  up_to_date = old && old->size() == paths.size();
+  ManifestFiles ret;
+  ret.reserve(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i)
+  {
+    ManifestFile f{
+      paths[i], boost::filesystem::file_size(paths[i]),
+      boost::filesystem::last_write_time(paths[i]), 0};
+    if (!(i < (old ? old->size() : 0) &&
+          ManifestFileMatches((*old)[i], f, need_hash)))
+    {
+      up_to_date = false;
+      if (!need_hash) return {};
+      f.hash = HashFile(f.path);
+    }
+    ret.push_back(std::move(f));
+  }
+  return ret;
+}
+
+static void ManifestDo(
+  const boost::filesystem::path& p, const char* ext,
+  void (*fun)(const boost::filesystem::path&))
+{
+  if (manifest_path.empty()) return fun(p);
+
+  // (binary, text/dir) pair, like in BaseDoAutoFun
+  bool import = boost::ends_with(p.native(), ext);
+  boost::filesystem::path bin = p, other = p;
+  if (import)
+    bin = p.native().substr(0, p.native().size() - strlen(ext));
+  else
+    other += ext;
+  auto key = (import ? "import:" : "export:") +
+    boost::filesystem::absolute(bin).string();
+
+  std::vector<boost::filesystem::path> roots{bin, other};
+  auto it = manifest.find(key);
+  bool up_to_date;
+  if (it != manifest.end())
+  {
+    auto cur = ManifestState(roots, &it->second, up_to_date, false);
+    if (up_to_date)
+    {
+      INF << "Up to date: " << p << std::endl;
+      it->second = std::move(cur); // update mtimes
+      return;
+    }
+  }
+
+  // only record it when fun succeeded (it throws otherwise), so failed
+  // operations are retried on the next run
+  fun(p);
+  manifest[key] = ManifestState(
+    roots, it == manifest.end() ? nullptr : &it->second, up_to_date, true);
+}
+
 namespace
 {
   enum class Mode
@@ -147,6 +516,16 @@ namespace
   } mode = Mode::AUTO_STRTOOL;
 }
 
+static bool ParseMode(const char* str, Mode& out)
+{
+  if (false); // NOLINT
+#define GEN_IFS(c, s, _) else if (strcmp(str, s) == 0) out = Mode::c;
+  MODE_PARS(GEN_IFS)
+#undef GEN_IFS
+  else return false;
+  return true;
+}
+
 static auto BaseDoAutoFun(const boost::filesystem::path& p, const char* ext)
 {
   boost::filesystem::path cl3, txt;
@@ -176,13 +555,24 @@ static void DoAutoTxt(const boost::filesystem::path& p)
   EnsureTxt(st);
   if (import)
   {
-    st.txt->ReadTxt(OpenIn(txt));
-    if (st.stcm) st.stcm->Fixup();
-    st.dump->Fixup();
-    st.dump->Dump(cl3);
+    try
+    {
+      st.txt->ReadTxt(OpenIn(txt));
+      if (st.stcm) st.stcm->Fixup();
+      st.dump->Fixup();
+      st.dump->Dump(cl3);
+      OpenCacheSaved(cl3);
+    }
+    catch (...)
+    {
+      // half-imported state, do not reuse it
+      OpenCacheErase(cl3);
+      throw;
+    }
   }
   else
     st.txt->WriteTxt(OpenOut(txt));
+  StatsMemory(cl3.string(), *st.dump);
 }
 
 #if LIBSHIT_WITH_LUA
@@ -198,7 +588,8 @@ static void DoAutoLua(const boost::filesystem::path& p)
     {
       Logger::Log("lua", Logger::ERROR, nullptr, 0, nullptr)
         << lua_tostring(vm, -1) << std::endl;
-      return;
+      // throw, so it's counted as a failure and --manifest retries it
+      LIBSHIT_THROW(std::runtime_error, "Lua import failed", "File", lua);
     }
     auto dmp = vm.Get<NotNull<SmartPtr<Dumpable>>>(-1);
     // hack? when importing a cl3, and we get a gbnl, put it into the
@@ -222,10 +613,71 @@ static void DoAutoLua(const boost::filesystem::path& p)
     auto st = SmartOpen(bin);
     EnsureTxt(st);
     OpenOut(lua) << "return " << *(st.stcm ? st.stcm : st.dump.get()) << '\n';
+    StatsMemory(bin.string(), *st.dump);
   }
 }
 #endif
 
+TEST_SUITE_BEGIN("Neptools::StcmEditor");
+static unsigned manifest_test_calls;
+static bool manifest_test_fail;
+static void ManifestTestFun(const boost::filesystem::path&)
+{
+  ++manifest_test_calls;
+  if (manifest_test_fail) LIBSHIT_THROW(std::runtime_error, "test failure");
+}
+
+TEST_CASE("manifest retries failed operations")
+{
+  auto dir = boost::filesystem::temp_directory_path() /
+    boost::filesystem::unique_path("neptools-test-%%%%-%%%%-%%%%");
+  boost::filesystem::create_directory(dir);
+  struct Cleanup
+  {
+    boost::filesystem::path p;
+    ~Cleanup()
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(p, ec);
+      manifest_path.clear();
+      manifest.clear();
+    }
+  } cleanup{dir};
+
+  manifest_path = dir / "manifest";
+  manifest.clear();
+  OpenOut(dir / "foo.bin") << "binary";
+  OpenOut(dir / "foo.bin.txt") << "text";
+  auto txt = dir / "foo.bin.txt";
+  manifest_test_calls = 0;
+
+  manifest_test_fail = true;
+  CHECK_THROWS(ManifestDo(txt, ".txt", ManifestTestFun));
+  CHECK(manifest.empty());
+  CHECK_THROWS(ManifestDo(txt, ".txt", ManifestTestFun));
+  CHECK(manifest_test_calls == 2);
+
+  manifest_test_fail = false;
+  ManifestDo(txt, ".txt", ManifestTestFun);
+  CHECK(manifest_test_calls == 3);
+  CHECK(manifest.size() == 1);
+
+  // now it's up to date, even after a reload
+  SaveManifest();
+  LoadManifest();
+  ManifestDo(txt, ".txt", ManifestTestFun);
+  CHECK(manifest_test_calls == 3);
+
+#if LIBSHIT_WITH_LUA
+  // lua errors are failures too
+  manifest.clear();
+  OpenOut(dir / "foo.bin.lua") << "error('test')";
+  CHECK_THROWS(ManifestDo(dir / "foo.bin.lua", ".lua", DoAutoLua));
+  CHECK(manifest.empty());
+#endif
+}
+TEST_SUITE_END();
+
 static void DoAutoCl3(const boost::filesystem::path& p)
 {
   if (boost::filesystem::is_directory(p))
@@ -298,6 +750,7 @@ static void DoAuto(const boost::filesystem::path& path)
 {
   bool (*pred)(const boost::filesystem::path&, bool);
   void (*fun)(const boost::filesystem::path& p);
+  const char* ext; // for ManifestDo
 
   switch (mode)
   {
@@ -313,15 +766,18 @@ static void DoAuto(const boost::filesystem::path& path)
         return IsBin(p) || IsTxt(p);
     };
     fun = DoAutoTxt;
+    ext = ".txt";
     break;
 
   case Mode::EXPORT_STRTOOL:
     pred = IsBin;
     fun = DoAutoTxt;
+    ext = ".txt";
     break;
   case Mode::IMPORT_STRTOOL:
     pred = IsTxt;
     fun = DoAutoTxt;
+    ext = ".txt";
     break;
 
   case Mode::AUTO_CL3:
@@ -334,15 +790,18 @@ static void DoAuto(const boost::filesystem::path& path)
         return IsCl3(p) || IsCl3Dir(p);
     };
     fun = DoAutoCl3;
+    ext = ".out";
     break;
 
   case Mode::UNPACK_CL3:
     pred = IsCl3;
     fun = DoAutoCl3;
+    ext = ".out";
     break;
   case Mode::PACK_CL3:
     pred = IsCl3Dir;
     fun = DoAutoCl3;
+    ext = ".out";
     break;
 
 #if LIBSHIT_WITH_LUA
@@ -358,24 +817,179 @@ static void DoAuto(const boost::filesystem::path& path)
         return IsBin(p) || IsLua(p);
     };
     fun = DoAutoLua;
+    ext = ".lua";
     break;
 
   case Mode::EXPORT_LUA:
     pred = IsBin;
     fun = DoAutoLua;
+    ext = ".lua";
     break;
 
   case Mode::IMPORT_LUA:
     pred = IsLua;
     fun = DoAutoLua;
+    ext = ".lua";
     break;
 #endif
 
   case Mode::MANUAL:
     throw InvalidParam{"Can't use auto files in manual mode"};
   }
-  RecDo(path, pred, fun);
+  RecDo(path, pred, [&](const auto& p) { ManifestDo(p, ext, fun); });
+}
+
+#if !LIBSHIT_OS_IS_WINDOWS
+// written by the signal handler, wakes up the poll in Serve
+static int serve_stop_pipe[2] = { -1, -1 };
+static void ServeSignal(int)
+{
+  auto err = errno;
+  char c = 0;
+  (void) !write(serve_stop_pipe[1], &c, 1);
+  errno = err;
+}
+
+// Line based protocol: the client sends "<mode> <file/directory>\n" (mode is
+// one of the --mode values), the server processes it like a non-option
+// argument and replies "ok\n" or "failed\n". Errors are logged by the server.
+// "shutdown\n" (or SIGINT/SIGTERM) stops the server. Clients are served one
+// after another, a client idle for more than a minute is dropped so it can't
+// block the others.
+static void Serve(const char* sock_path)
+{
+#define SYSERROR(x)                                           \
+  LIBSHIT_THROW(SystemError,                                  \
+                std::error_code{errno, std::system_category()}, \
+                "API function", x)
+
+  LowIo sock{socket(AF_UNIX, SOCK_STREAM, 0)};
+  if (sock.fd == -1) SYSERROR("socket");
+
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (strlen(sock_path) >= sizeof(addr.sun_path))
+    throw InvalidParam{"socket path too long"};
+  strcpy(addr.sun_path, sock_path);
+
+  // only remove a stale socket, not a random file or a running server's
+  struct stat st;
+  if (lstat(sock_path, &st) == 0)
+  {
+    if (!S_ISSOCK(st.st_mode))
+      throw InvalidParam{"socket path exists and is not a socket"};
+    LowIo probe{socket(AF_UNIX, SOCK_STREAM, 0)};
+    if (probe.fd == -1) SYSERROR("socket");
+    if (connect(probe.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0)
+      throw InvalidParam{"a server is already running on this socket"};
+    if (errno != ECONNREFUSED) SYSERROR("connect");
+    if (unlink(sock_path)) SYSERROR("unlink");
+  }
+
+  if (bind(sock.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)))
+    SYSERROR("bind");
+  // from now on we own the socket file, remove it however we exit
+  struct Cleanup
+  {
+    const char* path;
+    struct sigaction old_int, old_term;
+    ~Cleanup()
+    {
+      sigaction(SIGINT, &old_int, nullptr);
+      sigaction(SIGTERM, &old_term, nullptr);
+      for (auto& fd : serve_stop_pipe)
+        if (fd != -1) { close(fd); fd = -1; }
+      unlink(path);
+    }
+  } cleanup{sock_path, {}, {}};
+  sigaction(SIGINT, nullptr, &cleanup.old_int);
+  sigaction(SIGTERM, nullptr, &cleanup.old_term);
+
+  if (listen(sock.fd, 16)) SYSERROR("listen");
+  if (pipe(serve_stop_pipe)) SYSERROR("pipe");
+  fcntl(serve_stop_pipe[1], F_SETFL, O_NONBLOCK);
+  struct sigaction sa{};
+  sa.sa_handler = ServeSignal;
+  // don't break the file operations of a request, poll is woken up anyway
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  if (sigaction(SIGINT, &sa, nullptr) || sigaction(SIGTERM, &sa, nullptr))
+    SYSERROR("sigaction");
+
+  // waits until fd is readable: false on stop signal or timeout
+  auto wait = [](int fd, int timeout)
+  {
+    pollfd fds[2] = {{fd, POLLIN, 0}, {serve_stop_pipe[0], POLLIN, 0}};
+    while (true)
+    {
+      auto n = poll(fds, 2, timeout);
+      if (n == -1)
+      {
+        if (errno == EINTR) continue;
+        SYSERROR("poll");
+      }
+      return n > 0 && !fds[1].revents;
+    }
+  };
+
+  keep_open = true;
+  INF << "Listening on " << sock_path << std::endl;
+  bool stop = false;
+  while (!stop)
+  {
+    if (!wait(sock.fd, -1)) break;
+    LowIo cl{accept(sock.fd, nullptr, nullptr)};
+    if (cl.fd == -1)
+    {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      SYSERROR("accept");
+    }
+
+    std::string buf;
+    char tmp[4096];
+    ssize_t rd;
+    while (!stop && wait(cl.fd, 60*1000) &&
+           (rd = read(cl.fd, tmp, sizeof(tmp))) > 0)
+    {
+      buf.append(tmp, rd);
+      std::string::size_type nl;
+      while (!stop && (nl = buf.find('\n')) != std::string::npos)
+      {
+        auto line = buf.substr(0, nl);
+        buf.erase(0, nl+1);
+
+        auto sp = line.find(' ');
+        Mode req_mode;
+        bool ok = false;
+        if (line == "shutdown")
+          ok = stop = true;
+        else if (sp != std::string::npos &&
+                 ParseMode(line.substr(0, sp).c_str(), req_mode) &&
+                 req_mode != Mode::MANUAL)
+        {
+          mode = req_mode;
+          auto_failed = false;
+          try
+          {
+            DoAuto(line.substr(sp+1));
+            ok = !auto_failed;
+            if (!manifest_path.empty()) SaveManifest();
+          }
+          catch (...) { ERR << ExceptionToString() << std::endl; }
+        }
+        else
+          ERR << "Invalid request: " << line << std::endl;
+
+        // MSG_NOSIGNAL: don't die on SIGPIPE if the client is already gone
+        const char* reply = ok ? "ok\n" : "failed\n";
+        send(cl.fd, reply, strlen(reply), MSG_NOSIGNAL);
+      }
+    }
+  }
+  INF << "Server stopped" << std::endl;
+#undef SYSERROR
 }
+#endif
 
 int main(int argc, char** argv)
 {
@@ -391,11 +1005,8 @@ int main(int argc, char** argv)
 #undef GEN_HELP
     [](auto&& args)
     {
-      if (false); // NOLINT
-#define GEN_IFS(c, str, _) else if (strcmp(args.front(), str) == 0) mode = Mode::c;
-      MODE_PARS(GEN_IFS)
-#undef GEN_IFS
-      else throw InvalidParam{"invalid argument"};
+      if (!ParseMode(args.front(), mode))
+        throw InvalidParam{"invalid argument"};
     }};
 
   Option open_opt{
@@ -572,6 +1183,45 @@ int main(int argc, char** argv)
       if (st.stcm) st.stcm->Fixup();
     }};
 
+  Option manifest_opt{
+    hgrp, "manifest", 1, "FILE",
+    "Skip files unchanged since the last run, using the manifest FILE",
+    [&](auto&& args)
+    {
+      manifest_path = args.front();
+      LoadManifest();
+    }};
+
+  Option stats_opt{
+    hgrp, "stats", 0, nullptr,
+    "Print performance counters, time spent in each phase and memory usage "
+    "at exit",
+    [&](auto&&) { stats = true; Stats::Enable(true); }};
+
+  Option trace_opt{
+    hgrp, "trace", 1, "FILE",
+    "Write a timeline of the operations in Chrome trace format into FILE",
+    [&](auto&& args) { Trace::Start(args.front()); }};
+
+#if !LIBSHIT_OS_IS_WINDOWS
+  Option server_cache_opt{
+    lgrp, "server-cache", 1, "MIB",
+    "Keep at most about MIB megabytes of parsed files in server mode "
+    "(default 512, use before --server)",
+    [&](auto&& args)
+    {
+      open_cache_limit = std::size_t(std::stoul(args.front())) * 1024 * 1024;
+    }};
+  Option server_opt{
+    lgrp, "server", 1, "SOCKET",
+    "Process requests from unix socket SOCKET, keeping parsed files in memory",
+    [&](auto&& args)
+    {
+      mode = Mode::MANUAL;
+      Serve(args.front());
+    }};
+#endif
+
 #if LIBSHIT_WITH_LUA
   Option lua{
     lgrp, "lua", 'i', 0, nullptr, "Interactive lua prompt",
@@ -639,11 +1289,22 @@ int main(int argc, char** argv)
     parser.SetShowHelpOnNoOptions();
     parser.SetNonArgHandler(FUNC<DoAuto>);
 
-    try { parser.Run(argc, argv); }
+    try
+    {
+      parser.Run(argc, argv);
+      if (!manifest_path.empty()) SaveManifest();
+      Trace::Stop();
+      if (stats)
+      {
+        if (st.dump) StatsMemory("loaded file", *st.dump);
+        PrintStats();
+      }
+    }
     catch (const Exit& e) { return !e.success; }
     catch (...)
     {
       ERR << "Fatal error, aborting\n" << ExceptionToString() << std::endl;
+      if (stats) PrintStats();
       return 2;
     }
     return auto_failed;
@@ -18,6 +18,9 @@ namespace Libshit::Lua
     bld.AddFunction<
       static_cast<::Libshit::NotNull<Libshit::RefCountedPtr<::Neptools::Sink> > (*)(::boost::filesystem::path, ::Neptools::FilePosition, bool)>(::Neptools::Sink::ToFile)
     >("to_file");
+    bld.AddFunction<
+      static_cast<::Libshit::NotNull<Libshit::RefCountedPtr<::Neptools::Sink> > (*)(::boost::filesystem::path, bool)>(::Neptools::Sink::ToGrowingFile)
+    >("to_growing_file");
     bld.AddFunction<
       static_cast<::Libshit::NotNull<Libshit::RefCountedPtr<::Neptools::Sink> > (*)()>(::Neptools::Sink::ToStdOut)
     >("to_std_out");
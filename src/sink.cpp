@@ -1,5 +1,6 @@
 #include "sink.hpp"
 #include "low_io.hpp"
+#include "stats.hpp"
 
 #include <libshit/except.hpp>
 #include <libshit/lua/boost_endian_traits.hpp>
@@ -7,6 +8,17 @@
 #include <iostream>
 #include <fstream>
 
+#if !LIBSHIT_OS_IS_VITA
+#  include <algorithm>
+#  include <condition_variable>
+#  include <exception>
+#  include <mutex>
+#  include <thread>
+#  include <vector>
+#endif
+
+#include <boost/filesystem/operations.hpp>
+
 #include <libshit/doctest.hpp>
 
 #define LIBSHIT_LOG_NAME "sink"
@@ -20,13 +32,22 @@ namespace Neptools
     struct LIBSHIT_NOLUA MmapSink final : public Sink
     {
       MmapSink(LowIo&& io, FilePosition size);
+      // unknown size: grow the file as we go, truncate on Flush
+      MmapSink(LowIo&& io);
       ~MmapSink();
       void Write_(Libshit::StringView data) override;
       void Pad_(FileMemSize len) override;
+      void Flush() override;
 
       void MapNext(FileMemSize len);
+      void Grow(FilePosition min_size);
+      bool Regrow();
+      FileMemSize MapSize() const noexcept
+      { return grow ? LowIo::MMAP_CHUNK : buf_size; }
 
       LowIo io;
+      bool grow = false;
+      FilePosition file_size = 0;
     };
 
     struct LIBSHIT_NOLUA SimpleSink final : public Sink
@@ -42,9 +63,54 @@ namespace Neptools
       void Pad_(FileMemSize len) override;
       void Flush() override;
 
+      // write at the current offset
+      void Out(const void* ptr, FileMemSize len)
+      {
+        io.Write(ptr, len);
+        offset += len;
+      }
+
       LowIo io;
       Byte buf[LowIo::MEM_CHUNK];
     };
+
+#if !LIBSHIT_OS_IS_VITA
+    // Sequential writing where the actual writes happen on a background
+    // thread, so dumping doesn't have to wait for slow outputs (like pipes).
+    // Buffers start at MEM_CHUNK and double up to MAX_CHUNK as the output
+    // grows, the writer thread writes everything queued with one writev.
+    struct LIBSHIT_NOLUA WriteBehindSink final : public Sink
+    {
+      WriteBehindSink(LowIo io, FilePosition size);
+      ~WriteBehindSink();
+
+      void Write_(Libshit::StringView data) override;
+      void Pad_(FileMemSize len) override;
+      void Flush() override;
+
+      void Submit();
+      void Run() noexcept;
+
+      static constexpr const size_t MAX_CHUNK = 1024*1024; // 1MiB
+      static constexpr const size_t MAX_QUEUED = 4;
+
+      struct Buffer
+      {
+        std::unique_ptr<Byte[]> data;
+        FileMemSize size, used;
+      };
+
+      LowIo io;
+      Buffer cur;
+
+      std::mutex mutex;
+      std::condition_variable cond;
+      std::vector<Buffer> queue, free_bufs;
+      bool busy = false, stop = false;
+      std::exception_ptr error;
+      std::thread thread;
+    };
+#endif
   }
 
   MmapSink::MmapSink(LowIo&& io, FilePosition size) : Sink{size}
@@ -59,14 +125,61 @@ namespace Neptools
     this->io = std::move(io);
   }
 
+  MmapSink::MmapSink(LowIo&& io)
+    : Sink{FilePosition(-1)}, grow{true}, file_size{LowIo::MMAP_CHUNK}
+  {
+    io.Truncate(file_size);
+    io.PrepareMmap(true);
+    buf_size = LowIo::MMAP_CHUNK;
+    buf = static_cast<Byte*>(io.Mmap(0, LowIo::MMAP_CHUNK, true));
+
+    this->io = std::move(io);
+  }
+
   MmapSink::~MmapSink()
   {
     if (buf)
-      LowIo::Munmap(buf, buf_size);
+      LowIo::Munmap(buf, MapSize());
+    if (grow && Tell() != file_size)
+      try { io.Truncate(Tell()); }
+      catch (std::exception& e)
+      {
+        ERR << "~MmapSink " << Libshit::ExceptionToString() << std::endl;
+      }
+  }
+
+  void MmapSink::Grow(FilePosition min_size)
+  {
+    if (min_size <= file_size) return;
+    // grow geometrically, Flush cuts off the extra
+    auto grow_by = std::min(file_size / 2, FilePosition(-1) - file_size);
+    auto nsize = std::max(min_size, file_size + grow_by);
+    io.Truncate(nsize);
+    file_size = nsize;
+  }
+
+  // After a Flush the end of the mapping is past the end of the file, so the
+  // usable part of buf is limited to what was written. Extend the file again
+  // and give back the whole chunk.
+  bool MmapSink::Regrow()
+  {
+    if (!grow || buf_size == LowIo::MMAP_CHUNK) return false;
+    Grow(offset + LowIo::MMAP_CHUNK);
+    buf_size = LowIo::MMAP_CHUNK;
+    return true;
+  }
+
+  void MmapSink::Flush()
+  {
+    if (!grow) return;
+    io.Truncate(Tell());
+    file_size = Tell();
+    buf_size = buf_put;
   }
 
   void MmapSink::Write_(Libshit::StringView data)
   {
+    if (Regrow()) return Write(data);
     LIBSHIT_ASSERT(buf_put == buf_size && offset < size &&
                    buf_size == LowIo::MMAP_CHUNK);
 
@@ -78,6 +191,7 @@ namespace Neptools
       data.remove_prefix(to_write);
       offset += to_write;
       buf_put = 0;
+      file_size = std::max(file_size, offset);
     }
 
     MapNext(data.length());
@@ -89,6 +203,7 @@ namespace Neptools
 
   void MmapSink::Pad_(FileMemSize len)
   {
+    if (Regrow()) return Pad(len);
     LIBSHIT_ASSERT(buf_put == buf_size && offset < size &&
                    buf_size == LowIo::MMAP_CHUNK);
 
@@ -99,10 +214,20 @@ namespace Neptools
 
   void MmapSink::MapNext(FileMemSize len)
   {
+    Stats::Add(Stats::Counter::SINK_MMAP_NEXT);
     // wine fails on 0 size
     // windows fails if offset+size > file_length...
     // (linux doesn't care...)
-    if (offset < size)
+    if (grow)
+    {
+      Grow(offset + LowIo::MMAP_CHUNK);
+      void* nbuf = io.Mmap(offset, LowIo::MMAP_CHUNK, true);
+      io.Munmap(buf, MapSize());
+      buf = static_cast<Byte*>(nbuf);
+      buf_put = len;
+      buf_size = LowIo::MMAP_CHUNK;
+    }
+    else if (offset < size)
     {
       auto nbuf_size = std::min<FileMemSize>(LowIo::MMAP_CHUNK, size-offset);
       LIBSHIT_ASSERT(nbuf_size >= len);
@@ -132,8 +257,7 @@ namespace Neptools
   {
     if (buf_put)
     {
-      io.Write(buf, buf_put);
-      offset += buf_put;
+      Out(buf, buf_put);
       buf_put = 0;
     }
   }
@@ -142,13 +266,11 @@ namespace Neptools
   {
     LIBSHIT_ASSERT(buf_size == LowIo::MEM_CHUNK &&
                    buf_put == LowIo::MEM_CHUNK);
-    io.Write(buf, LowIo::MEM_CHUNK);
-    offset += LowIo::MEM_CHUNK;
+    Out(buf, LowIo::MEM_CHUNK);
 
     if (data.length() >= LowIo::MEM_CHUNK)
     {
-      io.Write(data.data(), data.length());
-      offset += data.length();
+      Out(data.data(), data.length());
       buf_put = 0;
     }
     else
@@ -162,22 +284,167 @@ namespace Neptools
   {
     LIBSHIT_ASSERT(buf_size == LowIo::MEM_CHUNK &&
                    buf_put == LowIo::MEM_CHUNK);
-    io.Write(buf, LowIo::MEM_CHUNK);
-    offset += LowIo::MEM_CHUNK;
+    Out(buf, LowIo::MEM_CHUNK);
 
     // assume we're not seekable (I don't care about not mmap-able but seekable
     // files)
-    if (len >= LowIo::MEM_CHUNK)
+    memset(buf, 0, std::min<FileMemSize>(len, LowIo::MEM_CHUNK));
+    for (; len > LowIo::MEM_CHUNK; len -= LowIo::MEM_CHUNK)
+      Out(buf, LowIo::MEM_CHUNK);
+    buf_put = len;
+  }
+
+#if !LIBSHIT_OS_IS_VITA
+  WriteBehindSink::WriteBehindSink(LowIo io, FilePosition size)
+    : Sink{size}, io{std::move(io)},
+      cur{std::unique_ptr<Byte[]>{new Byte[LowIo::MEM_CHUNK]},
+          LowIo::MEM_CHUNK, 0}
+  {
+    // Run can't allocate
+    queue.reserve(MAX_QUEUED);
+    free_bufs.reserve(2*MAX_QUEUED);
+    buf = cur.data.get();
+    buf_size = cur.size;
+  }
+
+  WriteBehindSink::~WriteBehindSink()
+  {
+    try { Flush(); }
+    catch (std::exception& e)
     {
-      memset(buf, 0, LowIo::MEM_CHUNK);
-      size_t i;
-      for (i = LowIo::MEM_CHUNK; i < len; i += LowIo::MEM_CHUNK)
-        io.Write(buf, LowIo::MEM_CHUNK);
-      offset += i - LowIo::MEM_CHUNK;
+      ERR << "~WriteBehindSink " << Libshit::ExceptionToString() << std::endl;
+    }
+
+    if (thread.joinable())
+    {
+      {
+        std::unique_lock lock{mutex};
+        stop = true;
+      }
+      cond.notify_all();
+      thread.join();
+    }
+  }
+
+  // queue the current buffer and get a new one
+  void WriteBehindSink::Submit()
+  {
+    auto nsize = std::min<FileMemSize>(cur.size * 2, MAX_CHUNK);
+    {
+      std::unique_lock lock{mutex};
+      cond.wait(lock, [&]() { return queue.size() < MAX_QUEUED || error; });
+      if (error) std::rethrow_exception(error);
+
+      // buffer sizes only grow, smaller free buffers won't be used again
+      free_bufs.erase(
+        std::remove_if(free_bufs.begin(), free_bufs.end(),
+                       [&](const auto& b) { return b.size != nsize; }),
+        free_bufs.end());
+      Buffer next;
+      if (!free_bufs.empty())
+      {
+        next = std::move(free_bufs.back());
+        free_bufs.pop_back();
+      }
+      else
+        next = {std::unique_ptr<Byte[]>{new Byte[nsize]}, nsize, 0};
+      if (!thread.joinable()) thread = std::thread{&WriteBehindSink::Run, this};
+
+      cur.used = buf_put;
+      queue.push_back(std::move(cur));
+      cur = std::move(next);
+    }
+    cond.notify_all();
+
+    offset += buf_put;
+    buf_put = 0;
+    buf = cur.data.get();
+    buf_size = cur.size;
+  }
+
+  void WriteBehindSink::Run() noexcept
+  {
+    std::vector<Buffer> bufs;
+    bufs.reserve(MAX_QUEUED);
+    LowIo::WriteVec vec[MAX_QUEUED];
+
+    std::unique_lock lock{mutex};
+    while (true)
+    {
+      cond.wait(lock, [&]() { return !queue.empty() || stop; });
+      if (queue.empty()) return;
+
+      bufs.swap(queue);
+      busy = true;
+      cond.notify_all();
+      if (!error)
+      {
+        lock.unlock();
+        for (size_t i = 0; i < bufs.size(); ++i)
+          vec[i] = {bufs[i].data.get(), bufs[i].used};
+        try { io.Writev(vec, bufs.size()); }
+        catch (...)
+        {
+          lock.lock();
+          error = std::current_exception();
+          lock.unlock();
+        }
+        lock.lock();
+      }
+      busy = false;
+
+      for (auto& b : bufs)
+        if (free_bufs.size() < free_bufs.capacity())
+          free_bufs.push_back(std::move(b));
+      bufs.clear();
+      cond.notify_all();
     }
-    else
-      memset(buf, 0, len);
-    buf_put = len % LowIo::MEM_CHUNK;
+  }
+
+  void WriteBehindSink::Flush()
+  {
+    if (buf_put) Submit();
+
+    std::unique_lock lock{mutex};
+    cond.wait(lock, [&]() { return (queue.empty() && !busy) || error; });
+    if (error) std::rethrow_exception(error);
+  }
+
+  void WriteBehindSink::Write_(Libshit::StringView data)
+  {
+    LIBSHIT_ASSERT(buf_put == buf_size);
+    do
+    {
+      Submit();
+      auto cp = std::min<FileMemSize>(data.length(), buf_size);
+      memcpy(buf, data.data(), cp);
+      data.remove_prefix(cp);
+      buf_put = cp;
+    } while (!data.empty());
+  }
+
+  void WriteBehindSink::Pad_(FileMemSize len)
+  {
+    LIBSHIT_ASSERT(buf_put == buf_size);
+    do
+    {
+      Submit();
+      auto cp = std::min(len, buf_size);
+      memset(buf, 0, cp);
+      len -= cp;
+      buf_put = cp;
+    } while (len);
+  }
+#endif
+
+  static Libshit::NotNull<Libshit::RefCountedPtr<Sink>> SequentialSink(
+    LowIo io, FilePosition size)
+  {
+#if LIBSHIT_OS_IS_VITA
+    return Libshit::MakeRefCounted<SimpleSink>(std::move(io), size);
+#else
+    return Libshit::MakeRefCounted<WriteBehindSink>(std::move(io), size);
+#endif
   }
 
   Libshit::NotNull<Libshit::RefCountedPtr<Sink>> Sink::ToFile(
@@ -188,14 +455,35 @@ namespace Neptools
       {
         LowIo io{fname.c_str(), true};
         if (LIBSHIT_OS_IS_VITA || !try_mmap)
-          return Libshit::MakeRefCounted<SimpleSink>(std::move(io), size);
+          return SequentialSink(std::move(io), size);
 
         try { return Libshit::MakeRefCounted<MmapSink>(std::move(io), size); }
         catch (const std::system_error& e)
         {
           WARN << "Mmmap failed, falling back to normal writing: "
                << Libshit::ExceptionToString() << std::endl;
-          return Libshit::MakeRefCounted<SimpleSink>(std::move(io), size);
+          return SequentialSink(std::move(io), size);
+        }
+      },
+      [&](auto& e) { Libshit::AddInfos(e, "File name", fname.string()); });
+  }
+
+  Libshit::NotNull<Libshit::RefCountedPtr<Sink>> Sink::ToGrowingFile(
+    boost::filesystem::path fname, bool try_mmap)
+  {
+    return Libshit::AddInfo(
+      [&]() -> Libshit::NotNull<Libshit::RefCountedPtr<Sink>>
+      {
+        LowIo io{fname.c_str(), true};
+        if (LIBSHIT_OS_IS_VITA || LIBSHIT_OS_IS_WINDOWS || !try_mmap)
+          return SequentialSink(std::move(io), -1);
+
+        try { return Libshit::MakeRefCounted<MmapSink>(std::move(io)); }
+        catch (const std::system_error& e)
+        {
+          WARN << "Mmmap failed, falling back to normal writing: "
+               << Libshit::ExceptionToString() << std::endl;
+          return SequentialSink(std::move(io), -1);
         }
       },
       [&](auto& e) { Libshit::AddInfos(e, "File name", fname.string()); });
@@ -203,7 +491,7 @@ namespace Neptools
 
   Libshit::NotNull<Libshit::RefCountedPtr<Sink>> Sink::ToStdOut()
   {
-    return Libshit::MakeRefCounted<SimpleSink>(LowIo::OpenStdOut(), -1);
+    return SequentialSink(LowIo::OpenStdOut(), -1);
   }
 
 #define TRY_MMAP                           \
@@ -392,6 +680,48 @@ namespace Neptools
     REQUIRE(is.eof());
   }
 
+  // only used directly on vita, test it here too
+  TEST_CASE("simple sink pad")
+  {
+    static constexpr FileMemSize C = LowIo::MEM_CHUNK;
+    // what's left for Pad_ after filling the buffer
+    FileMemSize rest;
+    SUBCASE("one chunk") { rest = C; }
+    SUBCASE("two chunks") { rest = 2*C; }
+    SUBCASE("partial") { rest = 2*C + 5; }
+    CAPTURE(rest);
+
+    char buf[16] = {0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15};
+    const FileMemSize pad = C - 16 + rest;
+    {
+      boost::filesystem::path fname{"tmp"};
+      auto sink = Libshit::MakeRefCounted<SimpleSink>(
+        LowIo{fname.c_str(), true}, 16*2 + pad);
+      sink->WriteGen(buf);
+      sink->Pad(pad);
+      REQUIRE(sink->Tell() == 16+pad);
+      sink->WriteGen(buf);
+      REQUIRE(sink->Tell() == 2*16+pad);
+    }
+
+    std::unique_ptr<char[]> buf2{new char[pad]};
+    std::ifstream is{"tmp", std::ios_base::binary};
+    is.read(buf2.get(), 16);
+    REQUIRE(is.good());
+    REQUIRE(memcmp(buf, buf2.get(), 16) == 0);
+
+    is.read(buf2.get(), pad);
+    REQUIRE(is.good());
+    REQUIRE(std::count(buf2.get(), buf2.get()+pad, 0) == pad);
+
+    is.read(buf2.get(), 16);
+    REQUIRE(is.good());
+    REQUIRE(memcmp(buf, buf2.get(), 16) == 0);
+
+    is.get();
+    REQUIRE(is.eof());
+  }
+
   TEST_CASE("sink helpers")
   {
     TRY_MMAP;
@@ -417,6 +747,49 @@ namespace Neptools
     REQUIRE(is.eof());
   }
 
+  TEST_CASE("growing file")
+  {
+    TRY_MMAP;
+    int buf[6] = {0,77,-123,98,77,-1};
+    static constexpr FilePosition SIZE = 3*1024*1024 / 24 * 24;
+    static constexpr FilePosition PAD = 1024*1024 + 5;
+    {
+      auto sink = Sink::ToGrowingFile("tmp", try_mmap);
+      for (FilePosition i = 0; i < SIZE; i += 24)
+      {
+        buf[0] = i/24;
+        sink->WriteGen(buf);
+        if (i == SIZE/2) sink->Flush();
+      }
+      sink->Pad(PAD);
+      sink->WriteGen(buf);
+      REQUIRE(sink->Tell() == SIZE+PAD+24);
+    }
+    REQUIRE(boost::filesystem::file_size("tmp") == SIZE+PAD+24);
+
+    std::unique_ptr<char[]> buf_exp{new char[SIZE+PAD+24]};
+    for (FilePosition i = 0; i < SIZE; i += 24)
+    {
+      buf[0] = i/24;
+      memcpy(buf_exp.get()+i, buf, 24);
+    }
+    memset(buf_exp.get()+SIZE, 0, PAD);
+    memcpy(buf_exp.get()+SIZE+PAD, buf, 24);
+
+    std::unique_ptr<char[]> buf_act{new char[SIZE+PAD+24]};
+    std::ifstream is{"tmp", std::ios_base::binary};
+    is.read(buf_act.get(), SIZE+PAD+24);
+    REQUIRE(is.good());
+    REQUIRE(memcmp(buf_exp.get(), buf_act.get(), SIZE+PAD+24) == 0);
+  }
+
+  TEST_CASE("growing file empty")
+  {
+    TRY_MMAP;
+    Sink::ToGrowingFile("tmp", try_mmap);
+    REQUIRE(boost::filesystem::file_size("tmp") == 0);
+  }
+
 
   void MemorySink::Write_(Libshit::StringView)
   { LIBSHIT_UNREACHABLE("MemorySink::Write_ called"); }
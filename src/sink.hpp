@@ -26,6 +26,10 @@ namespace Neptools
   public:
     static Libshit::NotNull<Libshit::RefCountedPtr<Sink>> ToFile(
       boost::filesystem::path fname, FilePosition size, bool try_mmap = true);
+    // When the size is not known in advance: the file is extended as needed
+    // and truncated to Tell() on Flush (and destruction).
+    static Libshit::NotNull<Libshit::RefCountedPtr<Sink>> ToGrowingFile(
+      boost::filesystem::path fname, bool try_mmap = true);
     static Libshit::NotNull<Libshit::RefCountedPtr<Sink>> ToStdOut();
 
     FilePosition Tell() const noexcept { return offset + buf_put; }
@@ -0,0 +1,224 @@
+#include "sjis.hpp"
+#include "sjis_table.hpp"
+
+#include <libshit/except.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include <libshit/doctest.hpp>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__SSE2__)
+#  define NEPTOOLS_SJIS_SSE2 1
+#  include <emmintrin.h>
+#else
+#  define NEPTOOLS_SJIS_SSE2 0
+#endif
+
+namespace Neptools::Sjis
+{
+  TEST_SUITE_BEGIN("Neptools::Sjis");
+
+  using Byte = unsigned char;
+
+  // length of the ASCII only prefix. Text is mostly ASCII (control codes,
+  // names, english text), and ASCII is the same in both encodings.
+  static std::size_t AsciiPrefix(const char* ptr, std::size_t len) noexcept
+  {
+    std::size_t i = 0;
+#if NEPTOOLS_SJIS_SSE2
+    for (; i + 16 <= len; i += 16)
+    {
+      auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + i));
+      if (auto mask = _mm_movemask_epi8(v)) return i + __builtin_ctz(mask);
+    }
+#else
+    for (; i + 8 <= len; i += 8)
+    {
+      std::uint64_t v;
+      memcpy(&v, ptr + i, 8);
+      if (v & UINT64_C(0x8080808080808080)) break;
+    }
+#endif
+    while (i < len && !(static_cast<Byte>(ptr[i]) & 0x80)) ++i;
+    return i;
+  }
+
+  static constexpr unsigned LEAD_COUNT = sizeof(TABLE) / sizeof(TABLE[0]);
+  static constexpr unsigned TRAIL_COUNT = sizeof(TABLE[0]) / sizeof(TABLE[0][0]);
+
+  static int LeadIndex(Byte c) noexcept
+  {
+    if (c >= 0x81 && c <= 0x9f) return c - 0x81;
+    if (c >= 0xe0 && c <= 0xfc) return c - 0xe0 + 0x1f;
+    return -1;
+  }
+
+  static Byte LeadByte(unsigned idx) noexcept
+  { return idx < 0x1f ? idx + 0x81 : idx - 0x1f + 0xe0; }
+
+  // unicode (BMP only, CP932 has nothing outside it) -> CP932 double byte code.
+  // Where more than one code maps to the same character (NEC/IBM extensions),
+  // the first one wins, like with python's cp932 codec.
+  static const std::uint16_t* GetReverseTable()
+  {
+    static const auto table = []
+    {
+      auto ret = std::make_unique<std::uint16_t[]>(0x10000);
+      for (unsigned l = 0; l < LEAD_COUNT; ++l)
+        for (unsigned t = 0; t < TRAIL_COUNT; ++t)
+          if (auto u = TABLE[l][t]; u && !ret[u])
+            ret[u] = (LeadByte(l) << 8) | (t + 0x40);
+      return ret;
+    }();
+    return table.get();
+  }
+
+  static void AppendUtf8(std::string& out, std::uint32_t u)
+  {
+    if (u < 0x80)
+      out.push_back(u);
+    else if (u < 0x800)
+    {
+      char buf[2] = { char(0xc0 | (u >> 6)), char(0x80 | (u & 0x3f)) };
+      out.append(buf, 2);
+    }
+    else
+    {
+      char buf[3] = { char(0xe0 | (u >> 12)), char(0x80 | ((u >> 6) & 0x3f)),
+                      char(0x80 | (u & 0x3f)) };
+      out.append(buf, 3);
+    }
+  }
+
+  void ToUtf8(Libshit::StringView in, std::string& out)
+  {
+    auto ptr = in.data();
+    auto len = in.size();
+    out.reserve(out.size() + len + len / 2);
+
+    for (std::size_t i = 0; i < len; )
+    {
+      auto n = AsciiPrefix(ptr + i, len - i);
+      out.append(ptr + i, n);
+      if ((i += n) == len) break;
+
+      Byte c = ptr[i];
+      if (c >= 0xa1 && c <= 0xdf) // half-width katakana
+      {
+        AppendUtf8(out, 0xff61 + (c - 0xa1));
+        ++i;
+        continue;
+      }
+
+      auto lead = LeadIndex(c);
+      Byte t = i + 1 < len ? ptr[i+1] : 0;
+      std::uint16_t u = 0;
+      if (lead >= 0 && t >= 0x40 && t < 0x40 + TRAIL_COUNT)
+        u = TABLE[lead][t - 0x40];
+      if (!u)
+        LIBSHIT_THROW(Libshit::DecodeError, "Invalid Shift-JIS sequence",
+                      "Offset", i);
+      AppendUtf8(out, u);
+      i += 2;
+    }
+  }
+
+  void FromUtf8(Libshit::StringView in, std::string& out)
+  {
+    auto ptr = in.data();
+    auto len = in.size();
+    out.reserve(out.size() + len);
+    const std::uint16_t* rev = nullptr;
+
+    for (std::size_t i = 0; i < len; )
+    {
+      auto n = AsciiPrefix(ptr + i, len - i);
+      out.append(ptr + i, n);
+      if ((i += n) == len) break;
+
+      Byte c = ptr[i];
+      unsigned cont;
+      std::uint32_t u, min;
+      if (c >= 0xc2 && c <= 0xdf) { cont = 1; u = c & 0x1f; min = 0x80; }
+      else if (c >= 0xe0 && c <= 0xef) { cont = 2; u = c & 0x0f; min = 0x800; }
+      else if (c >= 0xf0 && c <= 0xf4) { cont = 3; u = c & 0x07; min = 0x10000; }
+      else cont = 0;
+
+      bool ok = cont && i + cont < len;
+      for (unsigned j = 1; ok && j <= cont; ++j)
+      {
+        Byte b = ptr[i+j];
+        ok = (b & 0xc0) == 0x80;
+        u = (u << 6) | (b & 0x3f);
+      }
+      if (!ok || u < min || u > 0x10ffff || (u >= 0xd800 && u <= 0xdfff))
+        LIBSHIT_THROW(Libshit::DecodeError, "Invalid UTF-8 sequence",
+                      "Offset", i);
+
+      if (u >= 0xff61 && u <= 0xff9f)
+        out.push_back(0xa1 + (u - 0xff61));
+      else
+      {
+        if (!rev) rev = GetReverseTable();
+        auto code = u < 0x10000 ? rev[u] : 0;
+        if (!code)
+          LIBSHIT_THROW(Libshit::DecodeError,
+                        "Character not representable in Shift-JIS",
+                        "Offset", i, "Code point", u);
+        char buf[2] = { char(code >> 8), char(code & 0xff) };
+        out.append(buf, 2);
+      }
+      i += cont + 1;
+    }
+  }
+
+  TEST_CASE("ascii")
+  {
+    std::string str = "long enough ascii text to use the fast path: "
+      "0123456789abcdef";
+    CHECK(ToUtf8(str) == str);
+    CHECK(FromUtf8(str) == str);
+    CHECK(ToUtf8("") == "");
+  }
+
+  TEST_CASE("conversion")
+  {
+    // "テスト", half-width "ｱ", separator dash, NEC special (circled 1),
+    // mixed with ascii on both sides of a 16 byte block
+    std::string sjis =
+      "abc\x83\x65\x83\x58\x83\x67" "0123456789abcdefgh\xb1\x81\x5c\x87\x40!";
+    std::string utf8 =
+      "abc\xe3\x83\x86\xe3\x82\xb9\xe3\x83\x88" "0123456789abcdefgh"
+      "\xef\xbd\xb1\xe2\x80\x95\xe2\x91\xa0!";
+    CHECK(ToUtf8(sjis) == utf8);
+    CHECK(FromUtf8(utf8) == sjis);
+
+    // duplicate codes (U+7E8A is both an IBM extension and in NEC's selection
+    // of them): the first one is used when converting back
+    CHECK(ToUtf8("\xfa\x5c") == ToUtf8("\xed\x40"));
+    CHECK(FromUtf8(ToUtf8("\xfa\x5c")) == "\xed\x40");
+
+    std::string out = "x";
+    ToUtf8("\x82\xa0", out);
+    CHECK(out == "x\xe3\x81\x82");
+  }
+
+  TEST_CASE("invalid input")
+  {
+    CHECK_THROWS(ToUtf8("ab\x81"));      // truncated
+    CHECK_THROWS(ToUtf8("\x81\x7f"));    // invalid trail
+    CHECK_THROWS(ToUtf8("\x80"));        // invalid lead
+    CHECK_THROWS(ToUtf8("\x85\x40"));    // unassigned
+
+    CHECK_THROWS(FromUtf8("\x80"));             // lone continuation
+    CHECK_THROWS(FromUtf8("\xc0\x80"));         // overlong
+    CHECK_THROWS(FromUtf8("\xe3\x81"));         // truncated
+    CHECK_THROWS(FromUtf8("\xed\xa0\x80"));     // surrogate
+    CHECK_THROWS(FromUtf8("\xf0\x9f\x98\x80")); // not in CP932
+    CHECK_THROWS(FromUtf8("\xc2\xa5"));         // yen sign, neither
+  }
+
+  TEST_SUITE_END();
+}
@@ -0,0 +1,40 @@
+#ifndef UUID_A41F6C08_7D2E_4B93_9E15_38C0B7D2F6A4
+#define UUID_A41F6C08_7D2E_4B93_9E15_38C0B7D2F6A4
+#pragma once
+
+#include <libshit/nonowning_string.hpp>
+
+#include <string>
+
+namespace Neptools::Sjis
+{
+
+  // Conversion between CP932 (Microsoft's Shift-JIS variant, what the games
+  // use) and UTF-8. The result is appended to out. Invalid input or characters
+  // without a Shift-JIS equivalent throw Libshit::DecodeError with the byte
+  // offset.
+  void ToUtf8(Libshit::StringView in, std::string& out);
+  void FromUtf8(Libshit::StringView in, std::string& out);
+
+  inline std::string ToUtf8(Libshit::StringView in)
+  {
+    std::string ret;
+    ToUtf8(in, ret);
+    return ret;
+  }
+
+  inline std::string FromUtf8(Libshit::StringView in)
+  {
+    std::string ret;
+    FromUtf8(in, ret);
+    return ret;
+  }
+
+  // first byte of a double byte character. The second one can be in the ASCII
+  // range (like '\\' in 0x95 0x5c), so byte-wise searches must skip it.
+  inline bool IsLeadByte(unsigned char c) noexcept
+  { return (c >= 0x81 && c <= 0x9f) || (c >= 0xe0 && c <= 0xfc); }
+
+}
+
+#endif
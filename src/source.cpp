@@ -1,13 +1,18 @@
 #include "source.hpp"
+#include "memory_usage.hpp"
 #include "sink.hpp"
+#include "stats.hpp"
 
 #include <libshit/char_utils.hpp>
 #include <libshit/except.hpp>
 #include <libshit/lua/function_call.hpp>
 #include <libshit/platform.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <boost/endian/arithmetic.hpp>
 
 #if !LIBSHIT_OS_IS_WINDOWS
 #  include <unistd.h>
@@ -22,21 +27,57 @@ namespace Neptools
 {
   TEST_SUITE_BEGIN("Neptools::Source");
 
+  static Source::ChunkSizes chunk_sizes[] = {
+    // MMAP
+    { LowIo::MMAP_ALIGN, LowIo::MMAP_CHUNK, LowIo::MMAP_LIMIT },
+    // UNIX
+    { LowIo::MEM_CHUNK/2, LowIo::MEM_CHUNK, 32*LowIo::MEM_CHUNK },
+  };
+
+  Source::ChunkSizes Source::GetChunkSizes(ProviderType type) noexcept
+  { return chunk_sizes[static_cast<size_t>(type)]; }
+
+  void Source::SetChunkSizes(ProviderType type, const ChunkSizes& sizes)
+  {
+    auto pow2 = [](FileMemSize x) { return x && !(x & (x-1)); };
+    if (!pow2(sizes.min) || !pow2(sizes.initial) || !pow2(sizes.max) ||
+        sizes.min > sizes.initial || sizes.initial > sizes.max ||
+        (type == ProviderType::MMAP && sizes.min < LowIo::MMAP_ALIGN))
+      LIBSHIT_THROW(std::invalid_argument, "Invalid chunk sizes",
+                    "Min", sizes.min, "Initial", sizes.initial,
+                    "Max", sizes.max);
+    chunk_sizes[static_cast<size_t>(type)] = sizes;
+  }
+
   namespace
   {
 
     template <typename T>
     struct UnixLike : public Source::Provider
     {
-      UnixLike(LowIo io, boost::filesystem::path file_name, FilePosition size)
-        : Source::Provider{std::move(file_name), size}, io{std::move(io)} {}
+      UnixLike(LowIo io, boost::filesystem::path file_name, FilePosition size,
+               Source::ProviderType type)
+        : Source::Provider{std::move(file_name), size}, io{std::move(io)},
+          chunks{Source::GetChunkSizes(type)}, chunk_size{chunks.initial} {}
 
       void Destroy() noexcept;
 
       void Pread(FilePosition offs, Byte* buf, FileMemSize len) override;
+      void GetMemoryUsage(MemoryUsage& mu) const override;
       void EnsureChunk(FilePosition i);
+      void ReadAhead(FilePosition offs);
 
       LowIo io;
+
+      // readahead window, grows while chunks are requested sequentially
+      static constexpr const FileMemSize RA_MIN = LowIo::MMAP_CHUNK;
+      static constexpr const FileMemSize RA_MAX = 16*LowIo::MMAP_CHUNK;
+      FilePosition seq_next = -1, ra_end = 0;
+      FileMemSize ra_window = 0;
+
+      // current chunk size, see Source::ChunkSizes
+      Source::ChunkSizes chunks;
+      FileMemSize chunk_size;
     };
 
     struct MmapProvider final : public UnixLike<MmapProvider>
@@ -45,9 +86,11 @@ namespace Neptools
                    FilePosition size);
       ~MmapProvider() noexcept { Destroy(); }
 
-      static FileMemSize CHUNK_SIZE;
       void* ReadChunk(FilePosition offs, FileMemSize size);
       void DeleteChunk(size_t i);
+
+      // mapped address space, not heap
+      static constexpr const char MEMORY_CATEGORY[] = "source mmap chunks";
     };
 
     struct UnixProvider final : public UnixLike<UnixProvider>
@@ -56,12 +99,14 @@ namespace Neptools
       // workaround clang bug...
       UnixProvider(LowIo&& io, boost::filesystem::path file_name,
                    FilePosition size)
-        : UnixLike{std::move(io), std::move(file_name), size} {}
+        : UnixLike{std::move(io), std::move(file_name), size,
+                   Source::ProviderType::UNIX} {}
       ~UnixProvider() noexcept { Destroy(); }
 
-      static FileMemSize CHUNK_SIZE;
       void* ReadChunk(FilePosition offs, FileMemSize size);
       void DeleteChunk(size_t i);
+
+      static constexpr const char MEMORY_CATEGORY[] = "source read chunks";
     };
 
     struct StringProvider final : public Source::Provider
@@ -76,6 +121,8 @@ namespace Neptools
 
       void Pread(FilePosition, Byte*, FileMemSize) override
       { LIBSHIT_UNREACHABLE("StringProvider Pread"); }
+      void GetMemoryUsage(MemoryUsage& mu) const override
+      { mu.Add("source memory buffers", sizeof(*this) + str.capacity()); }
 
       std::string str;
     };
@@ -90,6 +137,8 @@ namespace Neptools
 
       void Pread(FilePosition, Byte*, FileMemSize) override
       { LIBSHIT_UNREACHABLE("UniquePtrProvider Pread"); }
+      void GetMemoryUsage(MemoryUsage& mu) const override
+      { mu.Add("source memory buffers", sizeof(*this) + size); }
 
       std::unique_ptr<char[]> data;
     };
@@ -144,11 +193,13 @@ namespace Neptools
 
   void Source::Pread_(FilePosition offs, Byte* buf, FileMemSize len) const
   {
+    Stats::Add(Stats::Counter::SOURCE_PREAD_BYTES, len);
     offs += offset;
     while (len)
     {
       if (p->LruGet(offs))
       {
+        Stats::Add(Stats::Counter::SOURCE_LRU_HITS);
         auto& x = p->lru[0];
         auto buf_offs = offs - x.offset;
         auto to_cpy = std::min(len, x.size - buf_offs);
@@ -158,7 +209,10 @@ namespace Neptools
         len -= to_cpy;
       }
       else
+      {
+        Stats::Add(Stats::Counter::SOURCE_LRU_MISSES);
         return p->Pread(offs, buf, len);
+      }
     }
   }
 
@@ -179,7 +233,12 @@ namespace Neptools
 
   Source::BufEntry Source::GetTemporaryEntry(FilePosition offs) const
   {
-    if (p->LruGet(offs)) return p->lru[0];
+    if (p->LruGet(offs))
+    {
+      Stats::Add(Stats::Counter::SOURCE_LRU_HITS);
+      return p->lru[0];
+    }
+    Stats::Add(Stats::Counter::SOURCE_LRU_MISSES);
     p->Pread(offs, nullptr, 0);
     LIBSHIT_ASSERT(p->lru[0].offset <= offs &&
                    p->lru[0].offset + p->lru[0].size > offs);
@@ -195,6 +254,17 @@ namespace Neptools
     return { e.ptr + eoffs, size };
   }
 
+  Libshit::StringView Source::GetCachedChunk(FilePosition offs) const
+  {
+    LIBSHIT_ASSERT(offs < size);
+    if (!p->LruGet(offs + offset)) return {"", 0};
+    Stats::Add(Stats::Counter::SOURCE_LRU_HITS);
+    auto& e = p->lru[0];
+    auto eoffs = offs + offset - e.offset;
+    auto size = std::min(e.size - eoffs, GetSize() - offs);
+    return { e.ptr + eoffs, size };
+  }
+
 
   void Source::Provider::LruPush(
     const Byte* ptr, FilePosition offset, FileMemSize size)
@@ -233,7 +303,7 @@ namespace Neptools
   void UnixLike<T>::Pread(FilePosition offs, Byte* buf, FileMemSize len)
   {
     LIBSHIT_ASSERT(io.fd != LowIo::INVALID_FD);
-    if (len > static_cast<T*>(this)->CHUNK_SIZE)
+    if (len > chunk_size)
       return io.Pread(buf, len, offs);
 
     if (len == 0) EnsureChunk(offs); // TODO: GetTemporaryEntry hack
@@ -249,25 +319,59 @@ namespace Neptools
     }
   }
 
+  template <typename T>
+  void UnixLike<T>::GetMemoryUsage(MemoryUsage& mu) const
+  {
+    FileMemSize sum = 0;
+    for (const auto& e : lru) sum += e.size;
+    mu.Add(T::MEMORY_CATEGORY, sum);
+    mu.Add("source providers", sizeof(T));
+  }
+
   template <typename T>
   void UnixLike<T>::EnsureChunk(FilePosition offs)
   {
-    auto const CHUNK_SIZE = static_cast<T*>(this)->CHUNK_SIZE;
-    auto ch_offs = offs/CHUNK_SIZE*CHUNK_SIZE;
     if (LruGet(offs)) return;
 
-    auto size = std::min(CHUNK_SIZE, this->size-ch_offs);
+    // chunks are aligned to the minimal size, not to the current one, so after
+    // a sequential miss the new chunk starts exactly where the last one ended,
+    // whatever the size is
+    auto ch_offs = offs/chunks.min*chunks.min;
+    bool seq = ch_offs == seq_next;
+    if (seq)
+      chunk_size = std::min(chunk_size*2, chunks.max);
+    else if (seq_next != FilePosition(-1))
+      chunk_size = std::max(chunk_size/2, chunks.min);
+
+    auto size = std::min(chunk_size, this->size-ch_offs);
+    if (seq) ReadAhead(ch_offs + size);
+    else ra_window = ra_end = 0;
+    seq_next = ch_offs + size;
+
+    Stats::Add(Stats::Counter::SOURCE_CHUNK_READS);
     auto x = static_cast<T*>(this)->ReadChunk(ch_offs, size);
     static_cast<T*>(this)->DeleteChunk(lru.size()-1);
     LruPush(static_cast<Byte*>(x), ch_offs, size);
   }
 
-  FileMemSize MmapProvider::CHUNK_SIZE = LowIo::MMAP_CHUNK;
+  template <typename T>
+  void UnixLike<T>::ReadAhead(FilePosition offs)
+  {
+    ra_window = std::clamp<FileMemSize>(ra_window*2, RA_MIN, RA_MAX);
+    FilePosition end = std::min<std::uint64_t>(
+      this->size, std::uint64_t(offs) + ra_window);
+    if (offs >= this->size || end <= ra_end) return;
+
+    auto start = std::max(offs, ra_end);
+    io.Prefetch(start, end - start);
+    ra_end = end;
+  }
+
   MmapProvider::MmapProvider(
     LowIo&& io, boost::filesystem::path file_name, FilePosition size)
-    : UnixLike{{}, std::move(file_name), size}
+    : UnixLike{{}, std::move(file_name), size, Source::ProviderType::MMAP}
   {
-    size_t to_map = size < LowIo::MMAP_LIMIT ? size : LowIo::MMAP_CHUNK;
+    size_t to_map = size < LowIo::MMAP_LIMIT ? size : chunk_size;
 
     io.PrepareMmap(false);
     void* ptr = io.Mmap(0, to_map, false);
@@ -283,6 +387,7 @@ namespace Neptools
     lru[0].ptr = static_cast<Byte*>(ptr);
     lru[0].offset = 0;
     lru[0].size = to_map;
+    seq_next = to_map;
   }
 
   void* MmapProvider::ReadChunk(FilePosition offs, FileMemSize size)
@@ -296,8 +401,6 @@ namespace Neptools
       io.Munmap(const_cast<Byte*>(lru[i].ptr), lru[i].size);
   }
 
-  FilePosition UnixProvider::CHUNK_SIZE = LowIo::MEM_CHUNK;
-
   void* UnixProvider::ReadChunk(FilePosition offs, FileMemSize size)
   {
     std::unique_ptr<Byte[]> x{new Byte[size]};
@@ -336,6 +439,11 @@ namespace Neptools
     }
   }
 
+  void Source::GetMemoryUsage(MemoryUsage& mu) const
+  {
+    if (mu.FirstSeen(p.get())) p->GetMemoryUsage(mu);
+  }
+
   void DumpableSource::Inspect_(std::ostream& os, unsigned) const
   {
     os << "neptools.dumpable_source(";
@@ -343,6 +451,12 @@ namespace Neptools
     os << ')';
   }
 
+  void DumpableSource::GetMemoryUsage_(MemoryUsage& mu) const
+  {
+    mu.AddObject(typeid(*this), sizeof(*this));
+    src.GetMemoryUsage(mu);
+  }
+
   std::string to_string(const Source& src)
   {
     std::stringstream ss;
@@ -352,13 +466,37 @@ namespace Neptools
 
 #if LIBSHIT_WITH_LUA
 
+  // Pushes [offs, offs+len) as a lua string. When it's inside an already
+  // loaded chunk (the usual case), the string is created straight from the
+  // chunk, without an intermediate buffer. Otherwise it goes through Pread, so
+  // reads larger than a chunk don't load (and evict) one for nothing.
+  static void LuaPushRange(
+    Libshit::Lua::StateRef vm, const Source& src, FilePosition offs,
+    FileMemSize len)
+  {
+    if (offs > src.GetSize() || len > src.GetSize() - offs)
+      LIBSHIT_THROW(SourceOverflow, "Source overflow", "Used source", src,
+                    "Read offset", offs, "Read size", len);
+    auto chunk = len ? src.GetCachedChunk(offs) : Libshit::StringView{"", 0};
+    if (chunk.size() >= len)
+    {
+      Stats::Add(Stats::Counter::SOURCE_PREAD_BYTES, len);
+      lua_pushlstring(vm, chunk.data(), len);
+    }
+    else
+    {
+      std::unique_ptr<char[]> ptr{new char[len]};
+      src.Pread(offs, ptr.get(), len);
+      lua_pushlstring(vm, ptr.get(), len);
+    }
+  }
+
   LIBSHIT_LUAGEN(name="read")
   static Libshit::Lua::RetNum LuaRead(
     Libshit::Lua::StateRef vm, Source& src, FileMemSize len)
   {
-    std::unique_ptr<char[]> ptr{new char[len]};
-    src.Read<Libshit::Check::Throw>(ptr.get(), len);
-    lua_pushlstring(vm, ptr.get(), len);
+    LuaPushRange(vm, src, src.Tell(), len);
+    src.Seek(src.Tell() + len);
     return {1};
   }
 
@@ -366,9 +504,7 @@ namespace Neptools
   static Libshit::Lua::RetNum LuaPread(
     Libshit::Lua::StateRef vm, Source& src, FilePosition offs, FileMemSize len)
   {
-    std::unique_ptr<char[]> ptr{new char[len]};
-    src.Pread<Libshit::Check::Throw>(offs, ptr.get(), len);
-    lua_pushlstring(vm, ptr.get(), len);
+    LuaPushRange(vm, src, offs, len);
     return {1};
   }
 
@@ -388,6 +524,137 @@ namespace Neptools
     CHECK(src.Inspect() ==
           R"(neptools.source.from_memory("tmp", "\x00\x01\x02\x03\x04\x05\x06\a\b\t\n\v\f\r\x0e\x0f"))");
   }
+
+  TEST_CASE("sequential read")
+  {
+    static constexpr FilePosition SIZE = 1024*1024 + 123;
+    std::unique_ptr<char[]> buf{new char[SIZE]};
+    for (FilePosition i = 0; i < SIZE; ++i) buf[i] = i*7;
+    {
+      std::ofstream os{"tmp", std::ios_base::binary};
+      os.write(buf.get(), SIZE);
+    }
+
+    boost::filesystem::path fname{"tmp"};
+    LowIo io{fname.c_str(), false};
+    auto src = Source::FromFd(fname, io.fd, false);
+    std::unique_ptr<char[]> buf2{new char[SIZE]};
+    for (FilePosition i = 0; i < SIZE; i += 1000)
+      src.Read(buf2.get() + i, std::min<FilePosition>(1000, SIZE - i));
+    REQUIRE(memcmp(buf.get(), buf2.get(), SIZE) == 0);
+  }
+
+  TEST_CASE("adaptive chunk size")
+  {
+    static constexpr FilePosition SIZE = 4*1024*1024;
+    {
+      std::string str(SIZE, 'x');
+      std::ofstream os{"tmp", std::ios_base::binary};
+      os << str;
+    }
+
+    boost::filesystem::path fname{"tmp"};
+    LowIo io{fname.c_str(), false};
+    auto src = Source::FromFd(fname, io.fd, false);
+    auto cs = Source::GetChunkSizes(Source::ProviderType::UNIX);
+
+    // sequential: doubles until max
+    FilePosition offs = 0;
+    FileMemSize last = 0;
+    for (int i = 0; i < 12; ++i)
+    {
+      auto ch = src.GetChunk(offs);
+      CHECK(ch.size() >= last);
+      last = ch.size();
+      offs += ch.size();
+    }
+    CHECK(last == cs.max);
+
+    // backwards: halves until min
+    Libshit::StringView ch;
+    for (FilePosition i = 1; i <= 12; ++i)
+      ch = src.GetChunk(SIZE - i*256*1024 + 100);
+    CHECK(ch.size() == cs.min - 100);
+
+    CHECK_THROWS(Source::SetChunkSizes(
+                   Source::ProviderType::UNIX, {4096, 1000, 8192}));
+    CHECK_THROWS(Source::SetChunkSizes(
+                   Source::ProviderType::MMAP, {4096, 4096, 4096}));
+  }
+
+  TEST_CASE("source cursor")
+  {
+    std::string str;
+    for (std::uint32_t i = 0; i < 10000; ++i)
+    {
+      boost::endian::little_uint32_t x = i;
+      str.append(reinterpret_cast<const char*>(&x), 4);
+    }
+    {
+      std::ofstream os{"tmp", std::ios_base::binary};
+      os << str;
+    }
+
+    boost::filesystem::path fname{"tmp"};
+    LowIo io{fname.c_str(), false};
+    // unix provider: 8KiB chunks, fields crossing chunk boundaries
+    for (auto src : {Source::FromMemory(str),
+                     Source::FromFd(fname, io.fd, false)})
+    {
+      src.Slice(2, str.size() - 4);
+      SourceCursor cur{src};
+      for (std::uint32_t i = 0; i < 9999; ++i)
+      {
+        auto x = cur.ReadUint32(Endian::LITTLE);
+        REQUIRE(x == ((i >> 16) | ((i+1) << 16)));
+      }
+      CHECK(cur.Tell() == src.GetSize());
+
+      cur.Seek(2);
+      CHECK(cur.ReadUint16(Endian::LITTLE) == 1);
+      CHECK(cur.Tell() == 4);
+    }
+  }
+
+  TEST_CASE("cached chunk")
+  {
+    {
+      std::ofstream os{"tmp", std::ios_base::binary};
+      os << std::string(100000, 'x');
+    }
+    boost::filesystem::path fname{"tmp"};
+    LowIo io{fname.c_str(), false};
+    auto src = Source::FromFd(fname, io.fd, false);
+    src.Slice(10, 90000);
+
+    CHECK(src.GetCachedChunk(0).empty());
+    auto ch = src.GetChunk(0);
+    auto cached = src.GetCachedChunk(0);
+    CHECK(cached.data() == ch.data());
+    CHECK(cached.size() == ch.size());
+    CHECK(src.GetCachedChunk(ch.size() - 1).size() == 1);
+
+    // reads larger than a chunk don't load anything
+    std::string buf(60000, '\0');
+    src.Pread(ch.size() + 10, buf.data(), buf.size());
+    CHECK(src.GetCachedChunk(ch.size() + 10).empty());
+
+    CHECK(Source::FromMemory("abc").GetCachedChunk(1).size() == 2);
+  }
+
+  TEST_CASE("source memory usage")
+  {
+    auto src = Source::FromMemory(std::string(1000, 'x'));
+    Source src2{src, 10, 20};
+
+    MemoryUsage mu;
+    src.GetMemoryUsage(mu);
+    src2.GetMemoryUsage(mu); // same provider, not counted again
+    auto& e = mu.GetEntries().at("source memory buffers");
+    CHECK(e.count == 1);
+    CHECK(e.bytes >= 1000);
+    CHECK(mu.GetTotal() == e.bytes);
+  }
   TEST_SUITE_END();
 }
 
@@ -15,6 +15,7 @@
 
 #include <array>
 #include <cstdint>
+#include <cstring>
 #include <boost/filesystem/path.hpp>
 
 namespace Neptools
@@ -178,6 +179,7 @@ namespace Neptools
       virtual ~Provider() = default;
 
       virtual void Pread(FilePosition offs, Byte* buf, FileMemSize len) = 0;
+      virtual void GetMemoryUsage(MemoryUsage& mu) const = 0;
 
       void LruPush(const Byte* ptr, FilePosition offset, FileMemSize size);
       bool LruGet(FilePosition offs);
@@ -196,6 +198,24 @@ namespace Neptools
     std::string Inspect() const;
 
     LIBSHIT_NOLUA Libshit::StringView GetChunk(FilePosition offs) const;
+    /// Like GetChunk, but only if the chunk is already in memory, returns an
+    /// empty view instead of reading from the file.
+    LIBSHIT_NOLUA Libshit::StringView GetCachedChunk(FilePosition offs) const;
+
+    /// Buffers of the underlying provider (once per provider).
+    LIBSHIT_NOLUA void GetMemoryUsage(MemoryUsage& mu) const;
+
+    /// Chunk sizes of file backed sources. A source starts with initial sized
+    /// chunks, doubles the size on every sequential cache miss and halves it
+    /// on random misses, staying between min and max (min == max gives fixed
+    /// size chunks). Sizes must be powers of two, chunks are aligned to min,
+    /// so for mmap min must be at least LowIo::MMAP_ALIGN. Only affects
+    /// sources opened after the change.
+    struct ChunkSizes { FileMemSize min, initial, max; };
+    enum class ProviderType { MMAP, UNIX };
+    LIBSHIT_NOLUA static ChunkSizes GetChunkSizes(ProviderType type) noexcept;
+    LIBSHIT_NOLUA static void SetChunkSizes(
+      ProviderType type, const ChunkSizes& sizes);
 
   private:
     // offset: in original file!
@@ -209,6 +229,85 @@ namespace Neptools
     Libshit::NotNull<Libshit::SmartPtr<Provider>> p;
   };
 
+  /// Sequential reader for parsers reading lots of small fields. Keeps the
+  /// current chunk of the source (see Source::GetChunk) and reads from it
+  /// directly, only going through Source when crossing a chunk boundary.
+  /// Like GetChunk's result, it's only valid until something else reads from
+  /// a Source sharing the same provider.
+  class SourceCursor
+  {
+  public:
+    SourceCursor(const Source& src, FilePosition offs) : src{&src}
+    { Fill(offs); }
+    explicit SourceCursor(const Source& src) : SourceCursor{src, src.Tell()} {}
+
+    FilePosition Tell() const noexcept { return base + (ptr - begin); }
+    void Seek(FilePosition offs)
+    {
+      if (offs >= base && offs - base <= FilePosition(end - begin))
+        ptr = begin + (offs - base);
+      else
+        Fill(offs);
+    }
+
+    template <typename Checker = Libshit::Check::Assert>
+    void Read(Byte* buf, FileMemSize len)
+    {
+      if (FileMemSize(end - ptr) >= len)
+      {
+        memcpy(buf, ptr, len);
+        ptr += len;
+      }
+      else
+        ReadSlow<Checker>(buf, len);
+    }
+    template <typename Checker = Libshit::Check::Assert>
+    void Read(char* buf, FileMemSize len)
+    { Read<Checker>(reinterpret_cast<Byte*>(buf), len); }
+
+    template <typename Checker = Libshit::Check::Assert, typename T>
+    void ReadGen(T& x)
+    { Read<Checker>(reinterpret_cast<Byte*>(&x), Libshit::EmptySizeof<T>); }
+
+    template <typename T, typename Checker = Libshit::Check::Assert>
+    T ReadGen() { T ret; ReadGen<Checker>(ret); return ret; }
+
+#define NEPTOOLS_GEN(bits)                                              \
+    template <typename Checker = Libshit::Check::Assert>                \
+    std::uint##bits##_t ReadUint##bits(Endian e)                        \
+    {                                                                   \
+      return ToNativeCopy(ReadGen<std::uint##bits##_t, Checker>(), e);  \
+    }
+    NEPTOOLS_GEN(8) NEPTOOLS_GEN(16) NEPTOOLS_GEN(32) NEPTOOLS_GEN(64)
+#undef NEPTOOLS_GEN
+
+  private:
+    template <typename Checker>
+    void ReadSlow(Byte* buf, FileMemSize len)
+    {
+      auto offs = Tell();
+      src->Pread<Checker>(offs, buf, len);
+      Fill(offs + len);
+    }
+
+    void Fill(FilePosition offs)
+    {
+      base = offs;
+      if (offs < src->GetSize())
+      {
+        auto chunk = src->GetChunk(offs);
+        begin = ptr = reinterpret_cast<const Byte*>(chunk.data());
+        end = begin + chunk.size();
+      }
+      else
+        begin = ptr = end = nullptr;
+    }
+
+    const Source* src;
+    FilePosition base;
+    const Byte* begin, * ptr, * end;
+  };
+
   inline std::ostream& operator<<(std::ostream& os, const Source s)
   { s.Inspect(os); return os; }
 
@@ -232,6 +331,7 @@ namespace Neptools
     Source src;
     void Dump_(Sink& sink) const override { src.Dump(sink); }
     void Inspect_(std::ostream& os, unsigned) const override;
+    void GetMemoryUsage_(MemoryUsage& mu) const override;
   };
 
 #define ADD_SOURCE(expr, ...) \
@@ -0,0 +1,33 @@
+// Auto generated code, do not edit. See gen_binding in project root.
+#if LIBSHIT_WITH_LUA
+#include <libshit/lua/user_type.hpp>
+
+
+const char ::Neptools::Stats::TYPE_NAME[] = "neptools.stats";
+
+namespace Libshit::Lua
+{
+
+  // class neptools.stats
+  template<>
+  void TypeRegisterTraits<::Neptools::Stats>::Register(TypeBuilder& bld)
+  {
+
+    bld.AddFunction<
+      static_cast<void (*)(bool) noexcept>(::Neptools::Stats::Enable)
+    >("enable");
+    bld.AddFunction<
+      static_cast<bool (*)() noexcept>(::Neptools::Stats::IsEnabled)
+    >("is_enabled");
+    bld.AddFunction<
+      static_cast<void (*)() noexcept>(::Neptools::Stats::Reset)
+    >("reset");
+    bld.AddFunction<
+      static_cast<::Libshit::Lua::RetNum (*)(::Libshit::Lua::StateRef)>(::Neptools::Stats::Get)
+    >("get");
+
+  }
+  static TypeRegister::StateRegister<::Neptools::Stats> reg_neptools_stats;
+
+}
+#endif
@@ -0,0 +1,216 @@
+#include "stats.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <boost/core/demangle.hpp>
+
+#include <libshit/doctest.hpp>
+
+namespace Neptools
+{
+  TEST_SUITE_BEGIN("Neptools::Stats");
+
+  static const char* const COUNTER_NAMES[] = {
+#define NEPTOOLS_GEN(c, n) n,
+    NEPTOOLS_STATS_COUNTERS(NEPTOOLS_GEN)
+#undef NEPTOOLS_GEN
+  };
+  static const char* const PHASE_NAMES[] = {
+#define NEPTOOLS_GEN(c, n) n,
+    NEPTOOLS_STATS_PHASES(NEPTOOLS_GEN)
+#undef NEPTOOLS_GEN
+  };
+
+  // strip namespace, Neptools::Stcm::InstructionItem -> Stcm::InstructionItem
+  std::string Stats::GetTypeName(const std::type_info& type)
+  {
+    auto str = boost::core::demangle(type.name());
+    if (str.compare(0, 10, "Neptools::") == 0) str.erase(0, 10);
+    return str;
+  }
+
+  std::size_t Stats::GetItemSize(const std::type_info& type) noexcept
+  {
+    for (auto c = item_counters; c; c = c->next)
+      if (c->type == type) return c->size;
+    return 0;
+  }
+
+  auto Stats::GetItems() -> std::vector<std::pair<std::string, std::uint64_t>>
+  {
+    std::vector<std::pair<std::string, std::uint64_t>> ret;
+    for (auto c = item_counters; c; c = c->next)
+      if (auto n = c->count.load(std::memory_order_relaxed))
+        ret.emplace_back(GetTypeName(c->type), n);
+    std::sort(ret.begin(), ret.end());
+    return ret;
+  }
+
+  void Stats::Reset() noexcept
+  {
+    for (auto& c : counters) c.store(0, std::memory_order_relaxed);
+    for (auto& p : phases) p.store(0, std::memory_order_relaxed);
+    for (auto c = item_counters; c; c = c->next)
+      c->count.store(0, std::memory_order_relaxed);
+  }
+
+  void Stats::Print(std::ostream& os)
+  {
+    os << "Statistics:\n";
+    for (unsigned i = 0; i < COUNTER_COUNT; ++i)
+      os << "  " << std::setw(20) << std::left << COUNTER_NAMES[i]
+         << std::right << counters[i].load(std::memory_order_relaxed) << '\n';
+
+    os << "Time:\n";
+    for (unsigned i = 0; i < PHASE_COUNT; ++i)
+      os << "  " << std::setw(20) << std::left << PHASE_NAMES[i] << std::right
+         << std::fixed << std::setprecision(3)
+         << phases[i].load(std::memory_order_relaxed) / 1e6 << " ms\n";
+
+    os << "Items created:\n";
+    for (const auto& [name, n] : GetItems())
+      os << "  " << std::setw(40) << std::left << name << std::right
+         << n << '\n';
+    os << std::flush;
+  }
+
+#if LIBSHIT_WITH_LUA
+  Libshit::Lua::RetNum Stats::Get(Libshit::Lua::StateRef vm)
+  {
+    auto top = lua_gettop(vm);
+    lua_createtable(vm, 0, COUNTER_COUNT + 2); // +1
+    for (unsigned i = 0; i < COUNTER_COUNT; ++i)
+    {
+      lua_pushnumber(vm, counters[i].load(std::memory_order_relaxed)); // +2
+      lua_setfield(vm, -2, COUNTER_NAMES[i]); // +1
+    }
+
+    lua_createtable(vm, 0, PHASE_COUNT); // +2
+    for (unsigned i = 0; i < PHASE_COUNT; ++i)
+    {
+      lua_pushnumber(vm, phases[i].load(std::memory_order_relaxed) / 1e9); // +3
+      lua_setfield(vm, -2, PHASE_NAMES[i]); // +2
+    }
+    lua_setfield(vm, -2, "time"); // +1
+
+    auto items = GetItems();
+    lua_createtable(vm, 0, items.size()); // +2
+    for (const auto& [name, n] : items)
+    {
+      lua_pushnumber(vm, n); // +3
+      lua_setfield(vm, -2, name.c_str()); // +2
+    }
+    lua_setfield(vm, -2, "items"); // +1
+
+    LIBSHIT_LUA_CHECKTOP(vm, top+1);
+    return 1;
+  }
+#endif
+
+  TEST_CASE("counters")
+  {
+    struct Dummy {};
+    Stats::Reset();
+    Stats::Add(Stats::Counter::LABELS_CREATED);
+    Stats::ItemCreated<Dummy>();
+    // disabled by default
+    CHECK(Stats::Get(Stats::Counter::LABELS_CREATED) == 0);
+    CHECK(Stats::GetItems().empty());
+
+    Stats::Enable(true);
+    Stats::Add(Stats::Counter::LABELS_CREATED);
+    Stats::Add(Stats::Counter::SOURCE_PREAD_BYTES, 42);
+    Stats::ItemCreated<Dummy>();
+    Stats::ItemCreated<Dummy>();
+    CHECK(Stats::Get(Stats::Counter::LABELS_CREATED) == 1);
+    CHECK(Stats::Get(Stats::Counter::SOURCE_PREAD_BYTES) == 42);
+    CHECK(Stats::Get(Stats::Counter::FIXUP_PASSES) == 0);
+
+    auto items = Stats::GetItems();
+    REQUIRE(items.size() == 1);
+    CHECK(items[0].second == 2);
+    CHECK(Stats::GetItemSize(typeid(Dummy)) == sizeof(Dummy));
+    CHECK(Stats::GetItemSize(typeid(int)) == 0);
+
+    Stats::Reset();
+    CHECK(Stats::Get(Stats::Counter::SOURCE_PREAD_BYTES) == 0);
+    CHECK(Stats::GetItems().empty());
+    Stats::Enable(false);
+  }
+
+  // waits until the clock advances, so timers can't measure zero
+  static void Tick() noexcept
+  {
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() == start);
+  }
+
+  TEST_CASE("nested phase timer")
+  {
+    Stats::Reset();
+    Stats::Enable(true);
+    {
+      Stats::PhaseTimer t{Stats::Phase::DUMP};
+      Tick();
+      {
+        Stats::PhaseTimer t2{Stats::Phase::DUMP};
+        Tick();
+      }
+      // inner timer didn't add anything
+      CHECK(Stats::Get(Stats::Phase::DUMP) == 0);
+      Tick();
+    }
+    // outer timer added the whole time once it closed
+    CHECK(Stats::Get(Stats::Phase::DUMP) > 0);
+    CHECK(Stats::Get(Stats::Phase::PARSE) == 0);
+    Stats::Enable(false);
+  }
+
+  TEST_CASE("mixed phase timers")
+  {
+    Stats::Reset();
+    Stats::Enable(true);
+    auto start = std::chrono::steady_clock::now();
+    {
+      Stats::PhaseTimer t{Stats::Phase::PARSE};
+      Tick();
+      {
+        // like a RecalcSize during parsing
+        Stats::PhaseTimer t2{Stats::Phase::FIXUP};
+        Tick();
+        {
+          Stats::PhaseTimer t3{Stats::Phase::PARSE};
+          Tick();
+        }
+      }
+      CHECK(Stats::Get(Stats::Phase::FIXUP) > 0);
+      // the innermost parse timer counts separately
+      auto inner_parse = Stats::Get(Stats::Phase::PARSE);
+      CHECK(inner_parse > 0);
+      Tick();
+      CHECK(Stats::Get(Stats::Phase::PARSE) == inner_parse);
+    }
+    auto wall = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+
+    auto parse = Stats::Get(Stats::Phase::PARSE);
+    auto fixup = Stats::Get(Stats::Phase::FIXUP);
+    CHECK(fixup > 0);
+    // each nanosecond is counted in exactly one phase
+    CHECK(parse + fixup <= std::uint64_t(wall));
+    Stats::Enable(false);
+
+    // disabled timers don't count
+    Stats::Reset();
+    {
+      Stats::PhaseTimer t{Stats::Phase::DUMP};
+      Tick();
+    }
+    CHECK(Stats::Get(Stats::Phase::DUMP) == 0);
+  }
+
+  TEST_SUITE_END();
+}
+
+#include "stats.binding.hpp"
@@ -0,0 +1,159 @@
+#ifndef UUID_5B0E7F24_8C3A_4F7B_9D61_2A4C8E1F3B57
+#define UUID_5B0E7F24_8C3A_4F7B_9D61_2A4C8E1F3B57
+#pragma once
+
+#include <libshit/lua/base.hpp>
+#include <libshit/lua/static_class.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+namespace Neptools
+{
+
+  // name in c++, name in lua/--stats
+#define NEPTOOLS_STATS_COUNTERS(x)                 \
+  x(SOURCE_PREAD_BYTES, "source_pread_bytes")      \
+  x(SOURCE_LRU_HITS,    "source_lru_hits")         \
+  x(SOURCE_LRU_MISSES,  "source_lru_misses")       \
+  x(SOURCE_CHUNK_READS, "source_chunk_reads")      \
+  x(SINK_MMAP_NEXT,     "sink_mmap_next")          \
+  x(LABELS_CREATED,     "labels_created")          \
+  x(FIXUP_PASSES,       "fixup_passes")
+
+#define NEPTOOLS_STATS_PHASES(x) \
+  x(PARSE, "parse")              \
+  x(FIXUP, "fixup")              \
+  x(TXT,   "txt")                \
+  x(DUMP,  "dump")
+
+  // Process wide performance counters. Disabled by default, in that case a
+  // counter or a phase timer costs a relaxed load and a branch; when enabled a
+  // counter is a relaxed atomic add.
+  class Stats final : public Libshit::Lua::StaticClass
+  {
+    LIBSHIT_LUA_CLASS;
+    using Clock = std::chrono::steady_clock;
+  public:
+#define NEPTOOLS_GEN(c, n) c,
+    enum class Counter { NEPTOOLS_STATS_COUNTERS(NEPTOOLS_GEN) };
+    enum class Phase { NEPTOOLS_STATS_PHASES(NEPTOOLS_GEN) };
+#undef NEPTOOLS_GEN
+#define NEPTOOLS_GEN(c, n) +1
+    static constexpr const unsigned COUNTER_COUNT =
+      0 NEPTOOLS_STATS_COUNTERS(NEPTOOLS_GEN);
+    static constexpr const unsigned PHASE_COUNT =
+      0 NEPTOOLS_STATS_PHASES(NEPTOOLS_GEN);
+#undef NEPTOOLS_GEN
+
+    static void Enable(bool on) noexcept
+    { enabled.store(on, std::memory_order_relaxed); }
+    static bool IsEnabled() noexcept
+    { return enabled.load(std::memory_order_relaxed); }
+
+    LIBSHIT_NOLUA static void Add(Counter c, std::uint64_t n = 1) noexcept
+    {
+      if (IsEnabled())
+        counters[static_cast<unsigned>(c)].fetch_add(
+          n, std::memory_order_relaxed);
+    }
+    LIBSHIT_NOLUA static std::uint64_t Get(Counter c) noexcept
+    { return counters[static_cast<unsigned>(c)].load(std::memory_order_relaxed); }
+
+    // nanoseconds spent in the phase
+    LIBSHIT_NOLUA static std::uint64_t Get(Phase p) noexcept
+    { return phases[static_cast<unsigned>(p)].load(std::memory_order_relaxed); }
+
+    // demangled type name -> number of items created, sorted by name
+    LIBSHIT_NOLUA static std::vector<std::pair<std::string, std::uint64_t>>
+    GetItems();
+
+    template <typename T>
+    LIBSHIT_NOLUA static void ItemCreated() noexcept
+    {
+      if (IsEnabled())
+        item_counter<T>.count.fetch_add(1, std::memory_order_relaxed);
+    }
+    // sizeof of an item type created through ItemCreated, or 0
+    LIBSHIT_NOLUA static std::size_t GetItemSize(
+      const std::type_info& type) noexcept;
+    // demangled name without the Neptools:: prefix
+    LIBSHIT_NOLUA static std::string GetTypeName(const std::type_info& type);
+
+    // Measures the time spent in a phase, excluding the time of other phases
+    // started inside it, so the phase totals add up to the wall time. Nested
+    // timers of the same phase (like the recursive Dump calls of children)
+    // are not counted twice.
+    class LIBSHIT_NOLUA PhaseTimer
+    {
+    public:
+      explicit PhaseTimer(Phase p) noexcept
+        : p{static_cast<unsigned>(p)}, parent{current}
+      {
+        active = IsEnabled() && !(parent && parent->p == this->p);
+        if (!active) return;
+        current = this;
+        start = Clock::now();
+      }
+      ~PhaseTimer() noexcept
+      {
+        if (!active) return;
+        std::uint64_t ns = std::chrono::duration_cast<
+          std::chrono::nanoseconds>(Clock::now() - start).count();
+        phases[p].fetch_add(ns - child_ns, std::memory_order_relaxed);
+        if (parent) parent->child_ns += ns;
+        current = parent;
+      }
+      PhaseTimer(const PhaseTimer&) = delete;
+      void operator=(const PhaseTimer&) = delete;
+
+    private:
+      unsigned p;
+      bool active;
+      PhaseTimer* parent;
+      std::uint64_t child_ns = 0;
+      Clock::time_point start;
+      // innermost active timer of the thread
+      static inline thread_local PhaseTimer* current = nullptr;
+    };
+
+    static void Reset() noexcept;
+    LIBSHIT_NOLUA static void Print(std::ostream& os);
+
+#if LIBSHIT_WITH_LUA
+    // Returns a table: counters by name, items = {type_name = count},
+    // time = {phase = seconds}.
+    static Libshit::Lua::RetNum Get(Libshit::Lua::StateRef vm);
+#endif
+
+  private:
+    struct ItemCounter
+    {
+      ItemCounter(const std::type_info& type, std::size_t size) noexcept
+        : type{type}, size{size}, next{item_counters} { item_counters = this; }
+
+      const std::type_info& type;
+      std::size_t size;
+      std::atomic<std::uint64_t> count{0};
+      ItemCounter* next;
+    };
+    // static init of these happens before main, and they're never removed
+    template <typename T>
+    static inline ItemCounter item_counter{typeid(T), sizeof(T)};
+    static inline ItemCounter* item_counters = nullptr;
+
+    static inline std::atomic<std::uint64_t> counters[COUNTER_COUNT];
+    static inline std::atomic<std::uint64_t> phases[PHASE_COUNT];
+    static inline std::atomic<bool> enabled{false};
+  };
+
+}
+
+#endif
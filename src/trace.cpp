@@ -0,0 +1,152 @@
+#include "trace.hpp"
+
+#include <libshit/except.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+
+#include <libshit/doctest.hpp>
+
+#define LIBSHIT_LOG_NAME "trace"
+#include <libshit/logger_helper.hpp>
+
+namespace Neptools
+{
+  TEST_SUITE_BEGIN("Neptools::Trace");
+
+  namespace
+  {
+    struct TraceFile
+    {
+      ~TraceFile() { Close(); }
+
+      void Close()
+      {
+        if (!os.is_open()) return;
+        os << "\n]\n";
+        os.close();
+      }
+
+      std::mutex mutex;
+      std::ofstream os;
+      std::chrono::steady_clock::time_point epoch;
+      bool first;
+    };
+  }
+
+  // constructed on first use, destroyed (and so the file completed) at exit
+  static TraceFile& GetFile()
+  {
+    static TraceFile file;
+    return file;
+  }
+
+  static std::atomic<unsigned> next_tid{1};
+  static thread_local unsigned tid = next_tid.fetch_add(1);
+
+  static void WriteJsonString(std::ostream& os, const char* str, size_t len)
+  {
+    os << '"';
+    for (size_t i = 0; i < len; ++i)
+    {
+      auto c = static_cast<unsigned char>(str[i]);
+      if (c == '"' || c == '\\') os << '\\' << c;
+      else if (c < 0x20)
+      {
+        char buf[8];
+        snprintf(buf, 8, "\\u%04x", c);
+        os << buf;
+      }
+      else os << c;
+    }
+    os << '"';
+  }
+
+  void Trace::Start(const boost::filesystem::path& fname)
+  {
+    auto& f = GetFile();
+    std::unique_lock lock{f.mutex};
+    f.Close();
+    f.os.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+    try { f.os.open(fname.c_str(), std::ios_base::binary); }
+    catch (const std::ios_base::failure&)
+    {
+      LIBSHIT_THROW(std::runtime_error, "Failed to open trace file",
+                    "File name", fname.string());
+    }
+    f.os.exceptions(std::ios_base::goodbit);
+    f.os << "[\n";
+    f.epoch = Clock::now();
+    f.first = true;
+    enabled.store(true, std::memory_order_relaxed);
+  }
+
+  void Trace::Stop()
+  {
+    enabled.store(false, std::memory_order_relaxed);
+    auto& f = GetFile();
+    std::unique_lock lock{f.mutex};
+    f.Close();
+  }
+
+  void Trace::Emit(const char* name, const std::string& detail,
+                   Clock::time_point start) noexcept
+  {
+    auto end = Clock::now();
+    auto& f = GetFile();
+    try
+    {
+      std::unique_lock lock{f.mutex};
+      if (!f.os.is_open()) return; // stopped while in the scope
+
+      using Us = std::chrono::duration<double, std::micro>;
+      if (!f.first) f.os << ",\n";
+      f.first = false;
+      f.os << "{\"name\":";
+      WriteJsonString(f.os, name, strlen(name));
+      f.os << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+           << ",\"ts\":" << Us{start - f.epoch}.count()
+           << ",\"dur\":" << Us{end - start}.count();
+      if (!detail.empty())
+      {
+        f.os << ",\"args\":{\"detail\":";
+        WriteJsonString(f.os, detail.data(), detail.size());
+        f.os << '}';
+      }
+      f.os << '}';
+    }
+    catch (...)
+    {
+      enabled.store(false, std::memory_order_relaxed);
+      ERR << "Failed to write trace event, tracing disabled" << std::endl;
+    }
+  }
+
+  TEST_CASE("trace events")
+  {
+    { Trace::Scope s{"not traced"}; }
+    Trace::Start("tmp");
+    CHECK(Trace::IsEnabled());
+    {
+      Trace::Scope s{"outer", Libshit::StringView{"a\"b"}};
+      Trace::Scope s2{"inner"};
+    }
+    Trace::Stop();
+    CHECK(!Trace::IsEnabled());
+    { Trace::Scope s{"not traced either"}; }
+
+    std::ifstream is{"tmp", std::ios_base::binary};
+    std::string str{std::istreambuf_iterator<char>{is},
+                    std::istreambuf_iterator<char>{}};
+    CHECK(str.find("\"inner\"") != std::string::npos);
+    CHECK(str.find("\"detail\":\"a\\\"b\"") != std::string::npos);
+    CHECK(str.find("not traced") == std::string::npos);
+    CHECK(str.front() == '[');
+    CHECK(str.compare(str.size() - 3, 3, "\n]\n") == 0);
+  }
+
+  TEST_SUITE_END();
+}
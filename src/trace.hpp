@@ -0,0 +1,64 @@
+#ifndef UUID_8E2D41A6_3F5C_4B9E_A7D0_61C9B2F4E835
+#define UUID_8E2D41A6_3F5C_4B9E_A7D0_61C9B2F4E835
+#pragma once
+
+#include <libshit/nonowning_string.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <boost/filesystem/path.hpp>
+
+namespace Neptools
+{
+
+  // Timeline of scoped events in Chrome's trace event format (open it in
+  // chrome://tracing or ui.perfetto.dev). Disabled by default, in that case a
+  // Scope costs a relaxed load and a branch.
+  class Trace final
+  {
+    using Clock = std::chrono::steady_clock;
+  public:
+    Trace() = delete;
+
+    // starts writing events to fname. The file is completed on Stop or at exit.
+    static void Start(const boost::filesystem::path& fname);
+    static void Stop();
+    static bool IsEnabled() noexcept
+    { return enabled.load(std::memory_order_relaxed); }
+
+    class Scope
+    {
+    public:
+      // name must be a string literal (or otherwise outlive the trace)
+      explicit Scope(const char* name) noexcept
+        : name{IsEnabled() ? name : nullptr}
+      { if (this->name) start = Clock::now(); }
+      Scope(const char* name, Libshit::StringView detail) : Scope{name}
+      { if (this->name) this->detail.assign(detail.data(), detail.size()); }
+      Scope(const char* name, const char* detail)
+        : Scope{name, Libshit::StringView{detail}} {}
+      Scope(const char* name, const boost::filesystem::path& detail)
+        : Scope{name}
+      { if (this->name) this->detail = detail.string(); }
+      ~Scope() noexcept { if (name) Emit(name, detail, start); }
+
+      Scope(const Scope&) = delete;
+      void operator=(const Scope&) = delete;
+
+    private:
+      const char* name;
+      std::string detail;
+      Clock::time_point start;
+    };
+
+  private:
+    static void Emit(const char* name, const std::string& detail,
+                     Clock::time_point start) noexcept;
+
+    static inline std::atomic<bool> enabled{false};
+  };
+
+}
+
+#endif
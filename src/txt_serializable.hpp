@@ -2,6 +2,9 @@
 #define UUID_E17CE799_6569_40E4_A8FE_39F088AE30AB
 #pragma once
 
+#include "stats.hpp"
+#include "trace.hpp"
+
 #include <libshit/meta.hpp>
 #include <libshit/lua/type_traits.hpp>
 #include <libshit/lua/dynamic_object.hpp>
@@ -16,10 +19,20 @@ namespace Neptools
   {
     LIBSHIT_LUA_CLASS;
   public:
-    LIBSHIT_NOLUA void WriteTxt(std::ostream& os) const { WriteTxt_(os); }
-    LIBSHIT_NOLUA void WriteTxt(std::ostream&& os) const { WriteTxt_(os); }
-    LIBSHIT_NOLUA void ReadTxt(std::istream& is) { ReadTxt_(is); }
-    LIBSHIT_NOLUA void ReadTxt(std::istream&& is) { ReadTxt_(is); }
+    LIBSHIT_NOLUA void WriteTxt(std::ostream& os) const
+    {
+      Stats::PhaseTimer t{Stats::Phase::TXT};
+      Trace::Scope tr{"WriteTxt"};
+      WriteTxt_(os);
+    }
+    LIBSHIT_NOLUA void WriteTxt(std::ostream&& os) const { WriteTxt(os); }
+    LIBSHIT_NOLUA void ReadTxt(std::istream& is)
+    {
+      Stats::PhaseTimer t{Stats::Phase::TXT};
+      Trace::Scope tr{"ReadTxt"};
+      ReadTxt_(is);
+    }
+    LIBSHIT_NOLUA void ReadTxt(std::istream&& is) { ReadTxt(is); }
 
   private:
     virtual void WriteTxt_(std::ostream& os) const = 0;
@@ -244,18 +244,17 @@ namespace Neptools::VitaPlugin
     DBG(1) << "Base: " << static_cast<const void*>(seg0.data())
            << ", size: " << seg0.size() << std::endl;
 
-    DBG(2) << "Finding GET_FILE_INFO" << std::endl;
-    auto get_file_info_addr = GET_FILE_INFO_PATTERN.Find(seg0);
-
-    DBG(2) << "Finding DECOMPRESS" << std::endl;
-    decompress = ThumbPtr<DecompressFun>(DECOMPRESS_PATTERN.Find(seg0));
-    DBG(2) << "Finding FS_BINDER_HANDLE_CREATE" << std::endl;
-    fs_binder_handle_create = ThumbPtr<FsBinderHandleCreateFun>(
-      FS_BINDER_HANDLE_CREATE_PATTERN.Find(seg0));
-
-    DBG(2) << "Finding DIR_FHAN" << std::endl;
-    auto dir_fhan_info = reinterpret_cast<const uint16_t*>(
-      DIR_FHAN_PATTERN.Find(seg0));
+    DBG(2) << "Finding GET_FILE_INFO, DECOMPRESS, FS_BINDER_HANDLE_CREATE, "
+      "DIR_FHAN" << std::endl;
+    auto found = PatternSet{
+      GET_FILE_INFO_PATTERN, DECOMPRESS_PATTERN,
+      FS_BINDER_HANDLE_CREATE_PATTERN, DIR_FHAN_PATTERN}.Find(seg0);
+    auto get_file_info_addr = found[0];
+
+    decompress = ThumbPtr<DecompressFun>(found[1]);
+    fs_binder_handle_create = ThumbPtr<FsBinderHandleCreateFun>(found[2]);
+
+    auto dir_fhan_info = reinterpret_cast<const uint16_t*>(found[3]);
     dir_fhan = reinterpret_cast<FileHandle*>(
       GetThumbImm16(dir_fhan_info) | (GetThumbImm16(dir_fhan_info+2) << 16));
     DBG(3) << "dir_fhan -> " << dir_fhan << std::endl;
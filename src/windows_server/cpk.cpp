@@ -295,18 +295,21 @@ namespace Neptools
 
   void CpkHandler::Init()
   {
-    DBG(1) << "Finding OPEN_FILE" << std::endl;
-    orig_open_file = Hook(FindImage(OPEN_FILE), &CpkHandler::OpenFile, 5);
-
-    DBG(1) << "Finding FILE_CLOSE" << std::endl;
-    auto offs = MaybeFindImage(FILE_CLOSE);
-    if (!offs) offs = FindImage(FILE_CLOSE_RB1PATCH);
-    orig_close_file = Hook(offs, &CpkHandler::CloseFile, 5);
-
-    DBG(1) << "Finding FILE_READ" << std::endl;
-    offs = MaybeFindImage(FILE_READ);
-    if (!offs) offs = FindImage(FILE_READ_RB1PATCH);
-    orig_read = Hook(offs, &CpkHandler::Read, 5);
+    DBG(1) << "Finding OPEN_FILE, FILE_CLOSE, FILE_READ" << std::endl;
+    auto found = MaybeFindImage(PatternSet{
+        OPEN_FILE, FILE_CLOSE, FILE_CLOSE_RB1PATCH, FILE_READ,
+        FILE_READ_RB1PATCH});
+    auto get = [&](size_t i, size_t fallback = -1)
+    {
+      auto ret = found[i];
+      if (!ret && fallback != static_cast<size_t>(-1)) ret = found[fallback];
+      if (!ret) LIBSHIT_THROW(std::runtime_error, "Couldn't find pattern");
+      return const_cast<Byte*>(ret);
+    };
+
+    orig_open_file = Hook(get(0), &CpkHandler::OpenFile, 5);
+    orig_close_file = Hook(get(1, 2), &CpkHandler::CloseFile, 5);
+    orig_read = Hook(get(3, 4), &CpkHandler::Read, 5);
   }
 
 }
@@ -16,6 +16,8 @@ namespace Neptools
   { return const_cast<Byte*>(pat.MaybeFind({image_base, GetImageSize()})); }
   inline Byte* FindImage(const Pattern& pat)
   { return const_cast<Byte*>(pat.Find({image_base, GetImageSize()})); }
+  inline std::vector<const Byte*> MaybeFindImage(const PatternSet& pats)
+  { return pats.MaybeFind({image_base, GetImageSize()}); }
 
   void* Hook(void* hook, void* dst, size_t copy);
 
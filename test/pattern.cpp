@@ -38,6 +38,11 @@ namespace Neptools::Test
       PatternParse::ByteSequence<0x11,0x00,0xf3,0x04>,
       PatternParse::ByteSequence<0xff,0x00,0xff,0xff>>>,
     "placeholder");
+  using Search = decltype(or_why_cant_you_add_a_sane_way_to_use);
+  static_assert(Search::search.anchor_offset == 2);
+  static_assert(Search::search.anchor_size == 2);
+  static_assert(Search::search.skip[0xf3] == 1 && Search::search.skip[0] == 2);
+  static_assert(Search::search.probe_a == 0 && Search::search.probe_b == 3);
 
   auto fucking_strings_as_template_arguments = NEPTOOLS_PATTERN("11 ? f3 04");
   static_assert(std::is_same_v<
@@ -181,5 +186,41 @@ namespace Neptools::Test
     CHECK_THROWS_AS(p.Find({data, sizeof(data)}), std::runtime_error);
   }
 
+  TEST_CASE("pattern set")
+  {
+    Byte pat[]  = { 0x58, 0xe0, 0x21, 0x28, 0x3e };
+    Byte mask[] = { 0xff, 0xf0, 0xff, 0x2f, 0x3f };
+    PatternSet ps{
+      NEPTOOLS_PATTERN("a8 fe 0 1c"),        // middle
+      NEPTOOLS_PATTERN("ff f0 64"),          // beginning
+      NEPTOOLS_PATTERN("18 e 2e b9 fc ce"),  // end
+      NEPTOOLS_PATTERN("12 34 56 76"),       // not match
+      NEPTOOLS_PATTERN("58 ec 21"),          // multiple match
+      NEPTOOLS_PATTERN("48 ? c5 ? ? be"),    // wildcards
+      NEPTOOLS_PATTERN("? 2e b9 ? ?"),       // wildcards end
+      NEPTOOLS_PATTERN("? ? ? ?"),           // wildcards multiple
+      Pattern{pat, mask, 5},                 // mask
+      NEPTOOLS_PATTERN("fe 00 1c"),          // suffix of the first one
+    };
+    auto res = ps.MaybeFind({data, sizeof(data)});
+    REQUIRE(res.size() == 10);
+    CHECK(res[0] == data + 0x1b);
+    CHECK(res[1] == data);
+    CHECK(res[2] == data + 0x3a);
+    CHECK(res[3] == nullptr);
+    CHECK(res[4] == nullptr);
+    CHECK(res[5] == data + 0x22);
+    CHECK(res[6] == data + 0x3b);
+    CHECK(res[7] == nullptr);
+    CHECK(res[8] == data + 0x18);
+    CHECK(res[9] == data + 0x1c);
+    CHECK_THROWS_AS(ps.Find({data, sizeof(data)}), std::runtime_error);
+
+    PatternSet ps2{
+      NEPTOOLS_PATTERN("a8 fe 0 1c"), NEPTOOLS_PATTERN("e ? b9 ? ce")};
+    auto res2 = ps2.Find({data, sizeof(data)});
+    CHECK(res2 == std::vector<const Byte*>{data + 0x1b, data + 0x3b});
+  }
+
   TEST_SUITE_END();
 }
@@ -0,0 +1,36 @@
+#!/usr/bin/env python3
+# Generates src/sjis_table.hpp, the CP932 double-byte -> unicode table used by
+# src/sjis.cpp, from python's cp932 codec.
+# Usage: tools/gen_sjis_table.py > src/sjis_table.hpp
+
+LEADS = list(range(0x81, 0xa0)) + list(range(0xe0, 0xfd))
+TRAILS = range(0x40, 0xfd)
+
+def decode(lead, trail):
+    try:
+        return ord(bytes([lead, trail]).decode('cp932'))
+    except UnicodeDecodeError:
+        return 0
+
+print('// Generated by tools/gen_sjis_table.py, do not edit.')
+print('#ifndef UUID_5B0E7C3A_92D4_4F61_B8A7_0C3E6D15F9B2')
+print('#define UUID_5B0E7C3A_92D4_4F61_B8A7_0C3E6D15F9B2')
+print('#pragma once')
+print()
+print('#include <cstdint>')
+print()
+print('namespace Neptools::Sjis')
+print('{')
+print('  // [lead byte][trail byte - 0x40] -> unicode, 0 if invalid. Lead bytes are')
+print('  // 0x81-0x9f, 0xe0-0xfc, see LeadIndex in sjis.cpp.')
+print('  static const std::uint16_t TABLE[%d][%d] = {' % (len(LEADS), len(TRAILS)))
+for lead in LEADS:
+    print('    { // 0x%02x' % lead)
+    row = [decode(lead, t) for t in TRAILS]
+    for i in range(0, len(row), 8):
+        print('      ' + ' '.join('0x%04x,' % c for c in row[i:i+8]))
+    print('    },')
+print('  };')
+print('}')
+print()
+print('#endif')